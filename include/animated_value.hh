@@ -7,15 +7,80 @@
 #include <functional>
 #include <memory>
 #include <ostream>
+#include <vector>
 
 namespace Sian {
 
 using StepID = std::uint64_t;
 
+// Increases whenever the value may have changed.
+using Revision = std::uint64_t;
+
+// State of an updatable value saved by save_state(). Only the value that saved it can
+// restore it.
+class ValueState
+{
+public:
+    virtual ~ValueState()
+    { }
+};
+
+// Notified whenever a value it observes may have changed, see UpdatableValue::observe().
+class ValueObserver
+{
+public:
+    virtual ~ValueObserver();
+
+    // Called by the thread changing the value, which may be any of the stepping threads.
+    virtual void value_changed() = 0;
+};
+
+// Observers of a value, which are only weakly referenced, so that they stop being notified
+// once their owners drop them.
+class ValueObservers
+{
+public:
+    // Adding an observer that is already present has no effect.
+    void add(const std::shared_ptr<ValueObserver>& observer);
+
+    // Takes over the observers of other, e.g. when values get connected.
+    void merge(const ValueObservers& other);
+
+    // Notifies all observers that still exist and forgets the others.
+    void notify();
+
+private:
+    std::vector<std::weak_ptr<ValueObserver>> observers;
+};
+
 class UpdatableValue
 {
 public:
     virtual void step(double time_delta, StepID step_id) = 0;
+
+    virtual Revision revision() const = 0;
+
+    // Makes the value notify the observer whenever its revision increases, for as long as
+    // the observer exists.
+    virtual void observe(const std::shared_ptr<ValueObserver>& observer) = 0;
+
+    // Returns true if the value will not change by stepping.
+    virtual bool is_settled() const = 0;
+
+    // Returns true if stepping by time_delta may finish the current strategy of the value,
+    // running its actions and starting the next instruction.
+    virtual bool may_finish(double time_delta) const = 0;
+
+    // Identifies the state stepped by step(), which connected values share. Values with
+    // different shared states can be stepped by different threads.
+    virtual const void* shared_state() const;
+
+    // Captures everything that stepping the value depends on, so that it can be brought back
+    // by restore_state().
+    virtual std::unique_ptr<ValueState> save_state() const = 0;
+
+    // Returns the value into the saved state. The revision keeps increasing.
+    virtual void restore_state(const ValueState& state) = 0;
 };
 
 template<typename T>
@@ -84,6 +149,23 @@ public:
 
     void step(double time_delta, StepID step_id) override;
 
+    Revision revision() const override;
+
+    // Connected values share their observers.
+    void observe(const std::shared_ptr<ValueObserver>& observer) override;
+
+    bool is_settled() const override;
+
+    bool may_finish(double time_delta) const override;
+
+    const void* shared_state() const override;
+
+    // The state consists of the current strategy, how far it has got, and the planned
+    // instructions, all with the actions attached to them.
+    std::unique_ptr<ValueState> save_state() const override;
+
+    void restore_state(const ValueState& state) override;
+
     template<typename U>
     friend std::ostream& operator<<(std::ostream& stream, const AnimatedValue<U>& animated_value);
 
@@ -92,6 +174,8 @@ private:
 
     struct DataWrapper;
 
+    struct State;
+
     std::shared_ptr<DataWrapper> data_wrapper;
 
     std::shared_ptr<Data>& data();
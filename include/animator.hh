@@ -2,32 +2,116 @@
 #define ANIMATOR_HH
 
 #include "config.hh"
+#include "frame_sink.hh"
 #include "scene.hh"
 
+#include <cstddef> // std::size_t
 #include <functional>
 #include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace Sian {
 
+// Resolution (in pixels) and quality in which the frames are rendered, and where they go.
+struct OutputTarget
+{
+    int width;
+    int height;
+    Quality quality;
+    std::shared_ptr<FrameSink> sink;
+};
+
 class Animator
 {
 public:
+    // Renders frames in the resolution and quality given by the config into a GifSink or
+    // a FrameArchiveSink if the config says so, or into an ImageSequenceSink otherwise.
     Animator(const Config& config, Scene& scene);
 
+    // Every stepped state of the scene is rendered once for each of the targets.
+    Animator(const Config& config, Scene& scene, std::vector<OutputTarget> targets);
+
+    // Renders the current frame and steps the scene. When the config says to resume, frames
+    // all targets still hold from an interrupted render are stepped over without rendering.
     void step();
 
     void wait(double duration);
 
+    // Moves the animation to the frame closest to the given time (in seconds) without rendering
+    // the frames in between. The scene is restored from the last checkpoint before the frame,
+    // if that saves stepping, and stepped from there. Seeking back needs such a checkpoint,
+    // otherwise std::logic_error is thrown. Only the timeline planned in the scene is replayed -
+    // changes a program makes between steps are not, and neither are effects of tick
+    // observers and actions outside of the scene.
+    void seek(double time);
+
+    // Makes the animator keep a checkpoint of the scene every interval (in seconds) of
+    // the animation, when stepping over it. Jumping to any frame then costs at most
+    // an interval of stepping. Zero, the default, disables checkpoints.
+    void set_checkpoint_interval(double interval);
+
+    // Limits how many checkpoints are kept (256 by default). Once there would be more, every
+    // other one is forgotten and the interval doubles, so that they keep covering the animation
+    // evenly.
+    void set_checkpoint_limit(std::size_t count);
+
+    // Forgets all checkpoints, e.g. once the planned timeline has been changed after seeking.
+    void clear_checkpoints();
+
+    // Answers requests of ScrubClients connecting to the UNIX domain socket for frames at any
+    // time of the planned timeline up to its duration (in seconds), until one of the clients
+    // stops the server. Frames are reached by seek() and rendered in the resolution and quality
+    // of the first target; checkpoints are kept every second unless an interval has been set.
+    // Requests are served by the given number of worker threads and the given number of the most
+    // recently rendered frames is kept for further requests.
+    void serve(
+            const std::string& socket_path,
+            double duration,
+            int workers = 4,
+            std::size_t cached_frames = 64);
+
     using TickObserver = std::function<void(double)>;
 
     void register_tick_observer(const TickObserver& observer);
 
+    // When enabled and there are more targets, the scene is drawn only once into
+    // a recording, which is then replayed in the resolution of every target.
+    void set_shared_recording(bool enabled);
+
     void finish();
 private:
+    struct Checkpoint
+    {
+        double time;
+        std::shared_ptr<const Scene::Checkpoint> scene;
+    };
+
+    // Steps the scene by a frame without rendering it.
+    void advance();
+
+    // Saves a checkpoint if the current frame is due to have one.
+    void keep_checkpoint();
+
+    // Tells the targets their render settings and finds out how many frames all of them hold
+    // from an interrupted render.
+    void resume();
+
     Config config;
     Scene& scene;
     double time;
-    int output_counter = 0;
+    long frame = 0;
+    // number of frames between checkpoints, or zero if disabled
+    long checkpoint_period = 0;
+    std::size_t checkpoint_limit = 256;
+    std::map<long, Checkpoint> checkpoints;
+    bool resumed = false;
+    // frames before this one have been kept from an interrupted render
+    long resume_frame = 0;
+    std::vector<OutputTarget> targets;
+    bool shared_recording = false;
     std::list<TickObserver> tick_observers;
 };
 
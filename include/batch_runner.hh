@@ -0,0 +1,56 @@
+#ifndef BATCH_RUNNER_HH
+#define BATCH_RUNNER_HH
+
+#include "animator.hh"
+#include "config.hh"
+#include "scene.hh"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Sian {
+
+// Renders several animations at once in one process, each by its own Scene and Animator.
+//
+// Animations rendered at once mustn't share any objects or animated values, and their scripts
+// mustn't touch other mutable state without synchronization. Everything Sian itself keeps for
+// the whole process is safe to use from several threads: messages of Logger are written
+// whole, Color::black, Color::white and Offset::origin are constants and the sprite memory
+// budget is shared by all scenes (it is set once for the process, not by the animations). Every animation needs its own output file, temporary
+// directory (unless it's saved as a GIF or into an archive) and frame archive.
+class BatchRunner
+{
+public:
+    // Builds the animation in the scene and renders it by calling the animator, which is
+    // finished once the script returns.
+    using Script = std::function<void(Scene& scene, Animator& animator)>;
+
+    // Renders at most the given number of animations at once. With 0, one per hardware
+    // thread is rendered.
+    explicit BatchRunner(int threads = 0);
+
+    // Throws std::invalid_argument if the animation would write into the same file or
+    // directory as one added before.
+    void add(const std::string& name, const Config& config, const Script& script);
+
+    // Renders all added animations, starting them in the order in which they were added.
+    // Once all of them have finished, throws std::runtime_error naming the animations that
+    // have failed, if any.
+    void run();
+
+private:
+    struct Job
+    {
+        std::string name;
+        Config config;
+        Script script;
+    };
+
+    int threads;
+    std::vector<Job> jobs;
+};
+
+} // namespace Sian
+
+#endif
@@ -23,10 +23,18 @@ public:
 
     virtual std::list<UpdatableValue*> animated_values() override;
 
+    virtual bool is_visible() const override;
+
+    virtual bool batchable() const override;
+
     AnimatedValue<double> radius;
 
 protected:
-    virtual void push_context(DrawContext cr) const override;
+    virtual void build_path(DrawContext cr) const override;
+
+    virtual bool geometry(Fingerprint& fingerprint) const override;
+
+    virtual double effective_line_width() const override;
 
     virtual double natural_width() const;
 
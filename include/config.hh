@@ -1,10 +1,76 @@
 #ifndef CONFIG_HH
 #define CONFIG_HH
 
+#include <cairo.h>
+
 #include <string>
 
 namespace Sian {
 
+enum class Quality
+{
+    DRAFT,
+    PREVIEW,
+    FINAL
+};
+
+// Format of images a sequence of frames is saved as.
+enum class ImageFormat
+{
+    PNG,
+    // much faster to write than PNG, readable by FFmpeg 5.1 or newer
+    QOI
+};
+
+// Filter applied to rows of PNG images before compressing them.
+enum class PngFilter
+{
+    NONE,
+    SUB,
+    UP,
+    AVERAGE,
+    PAETH,
+    // the filter compressing best is chosen for every row
+    ADAPTIVE
+};
+
+struct PngOptions
+{
+    // zlib level from 0 (no compression, fastest) to 9 (smallest files)
+    int compression_level = 6;
+    PngFilter filter = PngFilter::ADAPTIVE;
+};
+
+// How sinks write frames into files.
+struct WriterOptions
+{
+    // frames are encoded and written by this many background threads, or right away with 0
+    int threads = 0;
+    // rendering waits once this many frames wait for being written
+    int queue_depth = 8;
+    // files are written past the page cache (O_DIRECT), where the file system supports it
+    bool direct_io = false;
+};
+
+// Settings of rasterization following from the chosen quality.
+struct QualityProfile
+{
+    cairo_antialias_t antialias;
+    // frames are drawn at this fraction of the resolution of the animation
+    double render_scale;
+    // whether frames drawn at a lower resolution are scaled back to the resolution of the animation
+    bool upscale;
+    // RGB24 is cheaper to composite when the alpha channel of frames isn't needed
+    cairo_format_t format;
+    // maximal error (in pixels) of approximating curves by line segments
+    double tolerance;
+
+    static QualityProfile of(Quality quality);
+
+    // Dimension (in pixels) of frames rendered for an output of the given dimension.
+    int frame_dimension(int output_dimension) const;
+};
+
 class Config
 {
 public:
@@ -15,9 +81,30 @@ public:
     std::string temporary_directory;
     std::string output_file;
     bool require_empty_tmp_dir;
+    bool cull_offscreen;
+    bool batch_strokes;
+    int sprite_memory_budget; // in megabytes, see Object::set_sprite_memory_budget
+    int render_threads; // 0 means one per hardware thread
+    int step_threads; // 0 means one per hardware thread
+    Quality quality;
+    ImageFormat image_format;
+    PngOptions png_options;
+    WriterOptions writer_options;
+    // frames are encoded into an animated GIF instead of a video
+    bool gif_output;
+    // frames are piped to FFmpeg as they are drawn instead of saved as images
+    bool stream_output;
+    // when not empty, frames are stored in this archive file instead of a directory of PNGs
+    std::string frame_archive;
+    // frames kept by an interrupted render are reused instead of rendered again
+    bool resume;
+    // when not empty, the sample serves frames on demand over this UNIX domain socket
+    std::string scrub_socket;
 
     Config();
 
+    QualityProfile quality_profile() const;
+
     static Config from_args(int argc, char* argv[]);
 };
 
@@ -0,0 +1,52 @@
+#ifndef FFMPEG_STREAM_SINK_HH
+#define FFMPEG_STREAM_SINK_HH
+
+#include "config.hh"
+#include "frame_sink.hh"
+#include "scene.hh"
+#include "yuv.hh"
+
+#include <cstdio> // std::FILE
+#include <string>
+#include <vector>
+
+namespace Sian {
+
+// Streams frames to FFmpeg through a pipe. Frames are converted to YUV 4:2:0 in process,
+// which is less than half of the data of the drawn frames and spares FFmpeg its own conversion.
+class FfmpegStreamSink : public FrameSink
+{
+public:
+    // Uses the output file and fps given by the config.
+    explicit FfmpegStreamSink(const Config& config);
+
+    FfmpegStreamSink(
+            const std::string& output_file,
+            double fps,
+            ChromaLayout layout = ChromaLayout::I420);
+
+    virtual ~FfmpegStreamSink();
+
+    // Throws std::invalid_argument if the first frame has an odd width or height
+    // and std::runtime_error if FFmpeg has exited in the meantime.
+    virtual void write(const Scene::Snapshot& frame) override;
+
+    // Waits for FFmpeg to finish the video. Throws std::runtime_error if it has failed.
+    virtual void finish() override;
+
+private:
+    // FFmpeg is started with the first frame, once dimensions of frames are known.
+    void open(int width, int height);
+
+    std::string output_file;
+    double fps;
+    ChromaLayout layout;
+    std::FILE* pipe = nullptr;
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> buffer;
+};
+
+} // namespace Sian
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef FINGERPRINT_HH
+#define FINGERPRINT_HH
+
+#include "color.hh"
+#include "offset.hh"
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <vector>
+
+namespace Sian {
+
+// Hash of a sequence of values. Used as a key of caches, which are invalidated
+// when the fingerprint of the values they were computed from changes. The values
+// are kept as well, so fingerprints of different values are never equal, even
+// if their hashes collide.
+class Fingerprint
+{
+public:
+    Fingerprint& add(double value);
+
+    Fingerprint& add(std::uint64_t value);
+
+    Fingerprint& add(const Offset& value);
+
+    Fingerprint& add(const Color& value);
+
+    std::uint64_t value() const;
+
+    bool operator==(const Fingerprint& other) const;
+
+    bool operator!=(const Fingerprint& other) const;
+
+private:
+    // FNV-1a offset basis
+    std::uint64_t hash = 14695981039346656037ull;
+
+    // the first values are stored inline, so that short fingerprints don't allocate
+    static const std::size_t inline_capacity = 8;
+    std::size_t count = 0;
+    std::uint64_t inline_values[inline_capacity] = {};
+    std::vector<std::uint64_t> more_values;
+};
+
+} // namespace Sian
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef FRAME_ARCHIVE_READER_HH
+#define FRAME_ARCHIVE_READER_HH
+
+#include "frame_sink.hh"
+#include "scene.hh"
+
+#include <cairo.h>
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <string>
+
+namespace Sian {
+
+// Reads frames of an archive written by FrameArchiveSink, in any order. Frames can be read
+// while writers are still filling the archive.
+class FrameArchiveReader
+{
+public:
+    // Throws std::runtime_error if the file isn't an initialized frame archive.
+    explicit FrameArchiveReader(const std::string& path);
+
+    FrameArchiveReader(const FrameArchiveReader& other) = delete;
+
+    ~FrameArchiveReader();
+
+    int width() const;
+
+    int height() const;
+
+    cairo_format_t format() const;
+
+    double fps() const;
+
+    // One more than the index of the last frame written so far. Frames before it may still be
+    // missing when more writers fill the archive.
+    std::uint64_t frame_count() const;
+
+    bool has_frame(std::uint64_t frame);
+
+    // Decodes the frame into a new snapshot. Throws std::out_of_range if the frame hasn't
+    // been written yet.
+    Scene::Snapshot read(std::uint64_t frame);
+
+    // Writes all frames of the archive into the sink in order, without finishing it.
+    void feed(FrameSink& sink);
+
+private:
+    // Maps newly added slots, if writers have grown the file.
+    void update_mapping();
+
+    // Draws the frame into the surface, which has the dimensions and format of the archive.
+    void decode(std::uint64_t frame, cairo_surface_t* surface);
+
+    std::string path;
+    int fd = -1;
+    void* memory = nullptr;
+    std::size_t mapped_size = 0;
+    std::uint64_t mapped_capacity = 0;
+};
+
+} // namespace Sian
+
+#endif
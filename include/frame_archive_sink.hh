@@ -0,0 +1,85 @@
+#ifndef FRAME_ARCHIVE_SINK_HH
+#define FRAME_ARCHIVE_SINK_HH
+
+#include "config.hh"
+#include "frame_sink.hh"
+#include "scene.hh"
+
+#include <cairo.h>
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <string>
+
+namespace Sian {
+
+// Stores frames into slots of a single memory-mapped archive file, which can be read back by
+// FrameArchiveReader. The file is created with the first frame, once dimensions of frames are
+// known, and grows as needed. Several sinks, in the same or other processes, can write into one
+// archive at once, provided each of them writes different frames: the sink writes frames
+// first_frame, first_frame + frame_step, first_frame + 2 * frame_step, ...
+class FrameArchiveSink : public FrameSink
+{
+public:
+    // Uses the archive, the output file and fps given by the config. The sink is the only
+    // writer, so an existing archive is cleared. The archive is encoded into the output file
+    // once finished. Throws std::invalid_argument if the config asks for resuming, which
+    // archives don't support.
+    explicit FrameArchiveSink(const Config& config);
+
+    // Unless compressed, frames are drawn directly into the slots. When the output file isn't
+    // empty, finish() encodes the archive into it. An existing archive is joined, so that other
+    // writers can fill it at once; it has to have the same fps, dimensions and format.
+    FrameArchiveSink(
+            const std::string& path,
+            double fps,
+            bool compress = true,
+            std::uint64_t first_frame = 0,
+            std::uint64_t frame_step = 1,
+            const std::string& output_file = "");
+
+    virtual ~FrameArchiveSink();
+
+    virtual unsigned char* frame_buffer(
+            int width,
+            int height,
+            cairo_format_t format,
+            int& stride) override;
+
+    virtual void write(const Scene::Snapshot& frame) override;
+
+    // Flushes the archive to the file and encodes it into the output file, if there is one.
+    // Throws std::runtime_error if either fails.
+    virtual void finish() override;
+
+private:
+    void open(int width, int height, cairo_format_t format);
+
+    // Makes sure the file has a slot for the frame and that the slot is mapped.
+    void reserve(std::uint64_t frame);
+
+    void map(std::uint64_t capacity);
+
+    void close();
+
+    std::string path;
+    double fps;
+    bool compress;
+    std::uint64_t frame_step;
+    std::string output_file;
+    // whether other writers may fill the archive, otherwise it's cleared when opened
+    bool shared = true;
+
+    int fd = -1;
+    void* memory = nullptr;
+    std::size_t mapped_size = 0;
+    // number of slots mapped
+    std::uint64_t mapped_capacity = 0;
+    std::uint64_t next_frame;
+    // whether the slot of next_frame has been claimed
+    bool frame_begun = false;
+};
+
+} // namespace Sian
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef FRAME_SINK_HH
+#define FRAME_SINK_HH
+
+#include "config.hh"
+#include "scene.hh"
+
+#include <cairo.h>
+
+#include <cstdint>
+
+namespace Sian {
+
+// What the frames of an animation are rendered with, apart from the animation itself.
+struct RenderSettings
+{
+    int width;
+    int height;
+    Quality quality;
+    double fps;
+};
+
+// Receives rendered frames of the animation, in order.
+class FrameSink
+{
+public:
+    virtual ~FrameSink();
+
+    // Sinks keeping frames in their own memory can return a buffer for the next frame,
+    // together with its stride. The frame is then drawn directly into it before being
+    // passed to write(). Returns nullptr by default, letting the frame be drawn elsewhere.
+    virtual unsigned char* frame_buffer(int width, int height, cairo_format_t format, int& stride);
+
+    virtual void write(const Scene::Snapshot& frame) = 0;
+
+    // Tells the sink how its frames are rendered, before the first frame. Sinks able to resume
+    // keep only frames of an interrupted render with the same settings. Ignored by default.
+    virtual void set_render_settings(const RenderSettings& settings);
+
+    // Number of leading frames the sink still holds from an interrupted render of the same
+    // animation, which don't have to be rendered again. Asked once before the first frame when
+    // resuming. Returns 0 by default.
+    virtual std::uint64_t completed_frames();
+
+    // Makes the sink treat the first count frames as written, so that the next written frame
+    // is the frame count. The count is at most completed_frames().
+    virtual void skip_frames(std::uint64_t count);
+
+    // Called once all frames have been written.
+    virtual void finish() = 0;
+};
+
+} // namespace Sian
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef GIF_SINK_HH
+#define GIF_SINK_HH
+
+#include "color.hh"
+#include "config.hh"
+#include "frame_sink.hh"
+#include "scene.hh"
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstdio> // std::FILE
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Sian {
+
+namespace Gif {
+class PaletteMapper;
+}
+
+// Encodes frames into an animated GIF in a single pass, without FFmpeg. Every frame only
+// stores the rectangle that changed since the previous frame, with unchanged pixels inside it
+// left transparent. Frames identical to the previous one only prolong it. Transparency of
+// frames is flattened onto black.
+class GifSink : public FrameSink
+{
+public:
+    // Uses the output file and fps given by the config, looping forever.
+    explicit GifSink(const Config& config);
+
+    // When the animation only uses a few colors known in advance (at most 255), they can be
+    // given as the palette shared by all frames. Pixels of other colors (e.g. on antialiased
+    // edges) are drawn in the closest color of the palette. Otherwise every frame gets its own
+    // palette of the colors it needs. With a loop count of 0, the animation loops forever.
+    GifSink(
+            const std::string& output_file,
+            double fps,
+            const std::vector<Color>& palette = {},
+            int loop_count = 0);
+
+    virtual ~GifSink();
+
+    virtual void write(const Scene::Snapshot& frame) override;
+
+    virtual void finish() override;
+
+private:
+    // The file is created with the first frame, once dimensions of frames are known.
+    void open(int width, int height);
+
+    // Writes the last encoded frame, now that it is known how long it's shown.
+    void flush_pending();
+
+    // Number of hundredths of a second the frame is shown.
+    int frame_delay(long frame) const;
+
+    std::string output_file;
+    double fps;
+    std::vector<std::uint32_t> palette;
+    std::unique_ptr<Gif::PaletteMapper> palette_mapper;
+    int loop_count;
+
+    std::FILE* file = nullptr;
+    int width = 0;
+    int height = 0;
+    long frame_count = 0;
+    // colors of the previous frame as 0xRRGGBB
+    std::vector<std::uint32_t> previous;
+    std::vector<unsigned char> pending;
+    int pending_delay = 0;
+};
+
+} // namespace Sian
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef GRID_LAYOUT_HH
+#define GRID_LAYOUT_HH
+
+#include "layout.hh"
+#include "object.hh"
+#include "offset.hh"
+
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace Sian {
+
+// Places children into a table with given number of columns, filling it row by row.
+// Each column is as wide as its widest child and each row as high as its highest
+// child. Children are centered in their cells.
+class GridLayout : public Layout
+{
+public:
+    GridLayout(
+            const Offset& center,
+            int columns,
+            std::initializer_list<std::shared_ptr<Object>> children);
+
+    const int columns;
+
+protected:
+    virtual void arrange(std::vector<Slot>& slots, double& width, double& height) const override;
+
+private:
+    // reused between arrangements
+    mutable std::vector<double> column_widths;
+    mutable std::vector<double> row_heights;
+};
+
+} // namespace Sian
+
+#endif
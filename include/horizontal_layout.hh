@@ -1,7 +1,7 @@
 #ifndef HORIZONTAL_LAYOUT_HH
 #define HORIZONTAL_LAYOUT_HH
 
-#include "animated_value.hh"
+#include "layout.hh"
 #include "object.hh"
 #include "offset.hh"
 
@@ -11,23 +11,16 @@
 
 namespace Sian {
 
-class HorizontalLayout : public Object
+// Places children in a row, aligned to the top.
+class HorizontalLayout : public Layout
 {
 public:
     HorizontalLayout(
             const Offset& center,
             std::initializer_list<std::shared_ptr<Object>> children);
 
-    void draw(DrawContext cr) override;
-
-    virtual std::list<UpdatableValue*> animated_values() override;
-
-    std::vector<std::shared_ptr<Object>> children;
-
 protected:
-    virtual double natural_width() const;
-
-    virtual double natural_height() const;
+    virtual void arrange(std::vector<Slot>& slots, double& width, double& height) const override;
 };
 
 } // namespace Sian
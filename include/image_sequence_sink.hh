@@ -0,0 +1,115 @@
+#ifndef IMAGE_SEQUENCE_SINK_HH
+#define IMAGE_SEQUENCE_SINK_HH
+
+#include "config.hh"
+#include "frame_sink.hh"
+#include "scene.hh"
+
+#include <cstdint>
+#include <cstdio> // std::FILE
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Sian {
+
+class AsyncFileWriter;
+
+// Saves frames as numbered PNG or QOI files into a directory and joins them into
+// a video using FFmpeg once finished. Unless the writer options say otherwise, frames are
+// encoded and written by background threads and are kept alive until then. Every written
+// image is recorded in a manifest in the directory together with its checksum, so that
+// an interrupted render can be resumed. The manifest starts with the render settings and image
+// options, images of a render with other ones are never kept.
+class ImageSequenceSink : public FrameSink
+{
+public:
+    // Uses the temporary directory, the output file, the image settings and resuming given by
+    // the config.
+    explicit ImageSequenceSink(const Config& config);
+
+    // When resuming, images listed in the manifest of the directory are checked against their
+    // checksums, and the intact ones are kept instead of requiring an empty directory. Unless
+    // an empty directory is required, images of frames not kept are removed before the first
+    // frame is written; when resuming, that's also the case once none are kept.
+
+    ImageSequenceSink(
+            const std::string& directory,
+            const std::string& output_file,
+            double fps,
+            bool require_empty_directory = true,
+            ImageFormat format = ImageFormat::PNG,
+            const PngOptions& png_options = PngOptions(),
+            const WriterOptions& writer_options = WriterOptions(),
+            bool resume = false);
+
+    virtual ~ImageSequenceSink();
+
+    virtual void write(const Scene::Snapshot& frame) override;
+
+    virtual void set_render_settings(const RenderSettings& settings) override;
+
+    virtual std::uint64_t completed_frames() override;
+
+    virtual void skip_frames(std::uint64_t count) override;
+
+    // Encodes the images into the video. Throws std::runtime_error if FFmpeg has failed.
+    virtual void finish() override;
+
+private:
+    std::string extension() const;
+
+    // Numbers of the frames whose images are in the directory.
+    std::vector<std::uint64_t> images_in_directory() const;
+
+    // Makes sure no images of frames are in the directory yet.
+    void check_directory_empty() const;
+
+    // Removes images that would be joined into the video after the kept ones.
+    void prepare_directory();
+
+    std::string image_path(std::uint64_t frame) const;
+
+    std::string manifest_path() const;
+
+    // Keeps the frames listed in the manifest whose images are intact.
+    void load_manifest();
+
+    // Starts a new manifest listing the intact frames before the next one to be written.
+    void open_manifest();
+
+    // Appends the written image of the frame to the manifest.
+    void record(std::uint64_t frame, const std::vector<unsigned char>& image);
+
+    std::string directory;
+    std::string output_file;
+    double fps;
+    bool require_empty_directory;
+    bool resume;
+    ImageFormat format;
+    PngOptions png_options;
+    bool direct_io;
+    std::uint64_t output_counter = 0;
+
+    struct ManifestEntry
+    {
+        std::uint64_t size;
+        std::uint32_t checksum;
+    };
+
+    // what the images depend on apart from the animation, empty until the settings are known
+    std::string render_identity;
+    // that of the interrupted render, images are only kept when both are the same
+    std::string resumed_identity;
+    // frames kept from an interrupted render
+    std::map<std::uint64_t, ManifestEntry> intact_frames;
+    std::FILE* manifest = nullptr;
+    std::mutex manifest_mutex;
+    std::unique_ptr<AsyncFileWriter> writer;
+};
+
+} // namespace Sian
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef LAYER_HH
+#define LAYER_HH
+
+#include "animated_value.hh"
+#include "object.hh"
+
+#include <cairo.h>
+
+#include <cstddef> // std::size_t
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Sian {
+
+// Renders its child once into an offscreen surface and then only composites the
+// surface, until one of the child's animated values changes. Moving the child only
+// moves the surface. Suitable for parts of the scene that rarely change, such as grids,
+// axes or legends.
+// Layer follows the position of its child. Its own color only affects the opacity.
+class Layer : public Object
+{
+public:
+    explicit Layer(std::shared_ptr<Object> child);
+
+    virtual ~Layer();
+
+    virtual void draw(DrawContext cr) override;
+
+    virtual void layout() override;
+
+    virtual std::list<UpdatableValue*> animated_values() override;
+
+    virtual bool is_visible() const override;
+
+    virtual double bleed() const override;
+
+    virtual void appearance(Fingerprint& fingerprint) const override;
+
+protected:
+    virtual double natural_width() const override;
+
+    virtual double natural_height() const override;
+
+    virtual std::size_t child_count() const override;
+
+    virtual Object* nth_child(std::size_t i) const override;
+
+private:
+    struct Raster
+    {
+        std::shared_ptr<cairo_surface_t> surface;
+        Revision revision;
+        double scale_x;
+        double scale_y;
+        double margin;
+    };
+
+    void rasterize(DrawContext cr, Raster& raster);
+
+    std::shared_ptr<Object> child;
+    // one raster for every resolution the layer is drawn in
+    std::vector<Raster> rasters;
+    std::mutex raster_mutex;
+};
+
+} // namespace Sian
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef LAYOUT_HH
+#define LAYOUT_HH
+
+#include "animated_value.hh"
+#include "object.hh"
+#include "offset.hh"
+
+#include <cstddef> // std::size_t
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace Sian {
+
+// Base of Objects arranging a list of children. Positions of the children are
+// computed in the layout pass (see Scene::layout) and only when dimensions of
+// some of the children have changed. Drawing just uses the stored positions.
+class Layout : public Object
+{
+public:
+    Layout(
+            const Offset& center,
+            std::initializer_list<std::shared_ptr<Object>> children);
+
+    virtual ~Layout();
+
+    virtual void draw(DrawContext cr) override;
+
+    virtual void layout() override;
+
+    virtual std::list<UpdatableValue*> animated_values() override;
+
+    virtual bool is_visible() const override;
+
+    virtual void appearance(Fingerprint& fingerprint) const override;
+
+    std::vector<std::shared_ptr<Object>> children;
+
+protected:
+    // Space taken by a child. Dimensions are those of the child's wrapper box,
+    // center is given in natural coordinates of the layout.
+    struct Slot
+    {
+        double width;
+        double height;
+        double center_x;
+        double center_y;
+    };
+
+    // Fills in centers of the slots and returns natural dimensions of the layout.
+    virtual void arrange(std::vector<Slot>& slots, double& width, double& height) const = 0;
+
+    virtual double natural_width() const override;
+
+    virtual double natural_height() const override;
+
+    virtual std::size_t child_count() const override;
+
+    virtual Object* nth_child(std::size_t i) const override;
+
+    // Has to be called by the derived classes once they are fully constructed.
+    void update_arrangement() const;
+
+private:
+    // Returns false if the children or their dimensions changed since the last arrangement.
+    bool arrangement_valid() const;
+
+    mutable std::vector<Slot> slots;
+    mutable double width = 0;
+    mutable double height = 0;
+};
+
+} // namespace Sian
+
+#endif
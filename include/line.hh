@@ -21,11 +21,21 @@ public:
 
     virtual std::list<UpdatableValue*> animated_values() override;
 
+    virtual bool is_visible() const override;
+
+    virtual double bleed() const override;
+
+    virtual bool batchable() const override;
+
     AnimatedValue<Offset> start;
 
     AnimatedValue<Offset> end;
 
 protected:
+    virtual void build_path(DrawContext cr) const override;
+
+    virtual bool geometry(Fingerprint& fingerprint) const override;
+
     virtual double natural_width() const;
 
     virtual double natural_height() const;
@@ -3,12 +3,18 @@
 
 #include "animated_value.hh"
 #include "color.hh"
+#include "fingerprint.hh"
 #include "offset.hh"
 
 #include <cairo.h>
 
+#include <atomic>
+#include <cstddef> // std::size_t
 #include <functional> // std::reference_wrapper
 #include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace Sian {
 
@@ -28,10 +34,59 @@ public:
 
     virtual void draw(DrawContext cr) = 0;
 
+    // Draws the object, reusing its sprite if sprite caching is enabled.
+    void render(DrawContext cr);
+
+    // When enabled, the object is rasterized into a sprite, which is then only
+    // copied to the canvas as long as nothing but its position changes.
+    void set_sprite_caching(bool enabled);
+
+    bool sprite_caching() const;
+
+    // Limits the memory (in bytes) taken by sprites of all objects together. Objects
+    // whose sprites wouldn't fit are drawn directly. The budget belongs to the whole
+    // process and is shared by all of its scenes, so it should be set once at startup
+    // (e.g. from the -sprites option), before any scene is rendered.
+    static void set_sprite_memory_budget(std::size_t bytes);
+
+    // Adds all values affecting how the object looks, apart from its position,
+    // to the fingerprint. Objects drawing according to other values should override it.
+    virtual void appearance(Fingerprint& fingerprint) const;
+
+    // Updates positions of children (if there are any) and the transformation of the
+    // object. It is called by the scene before every snapshot, drawing shouldn't modify
+    // any animated values. Overrides have to call it once the children are laid out.
+    virtual void layout();
+
     virtual std::list<UpdatableValue*> animated_values();
 
+    // The values returned by animated_values(), collected again only when the children
+    // of the object (or theirs) have changed.
+    const std::vector<UpdatableValue*>& tracked_values();
+
+    // Makes the observer notified whenever any of the tracked values may have changed,
+    // or they have been collected again.
+    void observe(const std::shared_ptr<ValueObserver>& observer);
+
     void step(double time_delta, StepID step_id);
 
+    // Changes whenever any of the animated values of the object may have changed. The values
+    // notify the object about their changes, so this is only a lookup. Children added or
+    // removed since then are noticed by the next step() or layout().
+    Revision revision();
+
+    // Like revision(), but doesn't change when the object only moves.
+    Revision appearance_revision();
+
+    // Returns true if none of the animated values will change by stepping.
+    bool is_settled();
+
+    // Returns false if drawing the object in its current state would have no effect.
+    virtual bool is_visible() const;
+
+    // Distance by which the rendered object may extend beyond its wrapper box.
+    virtual double bleed() const;
+
     virtual void show_creation(const PaceValue& pace_value = Duration(1.0));
 
     virtual double x_dimension() const;
@@ -72,6 +127,101 @@ protected:
     virtual double natural_width() const = 0;
 
     virtual double natural_height() const = 0;
+
+    // Transformation from the natural coordinates of the object to the coordinates
+    // of its parent. It is kept from the last layout() and recomputed there only when
+    // the revision of the object has changed.
+    cairo_matrix_t local_matrix() const;
+
+    // Containers list their children, so that the tracked values are collected again
+    // whenever the children change.
+    virtual std::size_t child_count() const;
+
+    virtual Object* nth_child(std::size_t i) const;
+
+    // Draws a child so that its center ends up at the given point, without
+    // modifying any of the child's animated values.
+    static void draw_placed(DrawContext cr, Object& child, const Offset& placed_center);
+
+private:
+    struct Sprite
+    {
+        std::shared_ptr<cairo_surface_t> surface;
+        // linear part of the device transformation the sprite was rasterized with
+        Fingerprint scale_key;
+        Fingerprint key;
+        // position of the center of the object in the sprite
+        double origin_x;
+        double origin_y;
+        std::size_t bytes;
+        unsigned long last_used;
+    };
+
+    // Rasterizes the object into a new sprite, replacing the one with the same scale key
+    // or the least recently used one. Returns nullptr if it doesn't fit into the budget.
+    Sprite* rasterize_sprite(
+            DrawContext cr,
+            const cairo_matrix_t& device_matrix,
+            const Fingerprint& scale_key,
+            const Fingerprint& key);
+
+    void release_sprite(std::size_t i);
+
+    void release_sprites();
+
+    // Computes the transformation returned by local_matrix() from the current values.
+    cairo_matrix_t compute_local_matrix() const;
+
+    // Collects the tracked values again and makes them notify the observers.
+    void collect_values();
+
+    void forget_dropped_observers();
+
+    // Returns false if the children (or theirs) have changed since the values were collected.
+    bool tracked_values_current() const;
+
+    // Like tracked_values_current(), but assumes that the children have collected their
+    // values again if theirs have changed, so that only the direct children are compared.
+    bool children_current() const;
+
+    // Counts changes of the values it observes.
+    class ChangeCounter : public ValueObserver
+    {
+    public:
+        virtual void value_changed() override;
+
+        // may be read by drawing threads
+        std::atomic<Revision> count{1};
+    };
+
+    struct TransformCache
+    {
+        bool valid = false;
+        Revision revision;
+        cairo_matrix_t matrix;
+    };
+
+    // only written in the layout pass, so that drawing threads can read it without locking
+    TransformCache transform_cache;
+
+    std::vector<UpdatableValue*> values;
+    bool values_collected = false;
+    // changes of all the tracked values, and of those that don't only move the object
+    std::shared_ptr<ChangeCounter> changes = std::make_shared<ChangeCounter>();
+    std::shared_ptr<ChangeCounter> appearance_changes = std::make_shared<ChangeCounter>();
+    // observers added by observe(), which are notified by the values collected later too
+    std::vector<std::weak_ptr<ValueObserver>> observers;
+    // increases whenever the values are collected again
+    unsigned long values_generation = 0;
+    // children when the values were collected, and the sum of their generations
+    std::vector<const Object*> tracked_children;
+    unsigned long tracked_generations = 0;
+
+    bool sprite_caching_enabled = false;
+    // one sprite for every resolution the object is drawn in
+    std::vector<std::unique_ptr<Sprite>> sprites;
+    unsigned long sprite_clock = 0;
+    std::mutex sprite_mutex;
 };
 
 } // namespace Sian
@@ -0,0 +1,121 @@
+#ifndef PARTICLE_SYSTEM_HH
+#define PARTICLE_SYSTEM_HH
+
+#include "animated_value.hh"
+#include "color.hh"
+#include "object.hh"
+#include "offset.hh"
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint32_t
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace Sian {
+
+// Large number of filled circles (particles) stored in contiguous buffers instead of
+// separate Objects. Particles are drawn with one path per style and their positions
+// are integrated in a single pass over the buffers. The system as a whole is an ordinary
+// Object - its position, scale, rotation, color and completion can be animated.
+// Positions of particles are relative to the top left corner of the system, which
+// they shouldn't leave.
+class ParticleSystem : public Object
+{
+public:
+    using Style = std::uint32_t;
+
+    // The default style, which uses the color of the system.
+    static const Style default_style = 0;
+
+    ParticleSystem(Offset center, double width, double height);
+
+    virtual ~ParticleSystem();
+
+    // Returns identifier of a new style. Alpha of the style is multiplied by alpha
+    // of the system.
+    Style add_style(const Color& color);
+
+    // Returns index of the new particle. Velocity is given in pixels per second.
+    std::size_t add(
+            const Offset& position,
+            double radius,
+            const Offset& velocity = Offset::origin,
+            Style style = default_style);
+
+    void reserve(std::size_t count);
+
+    std::size_t size() const;
+
+    // Has to be called after the buffers below are modified directly.
+    void invalidate();
+
+    virtual void draw(DrawContext cr) override;
+
+    virtual std::list<UpdatableValue*> animated_values() override;
+
+    virtual bool is_visible() const override;
+
+    virtual void appearance(Fingerprint& fingerprint) const override;
+
+    AnimatedValue<double> width;
+
+    AnimatedValue<double> height;
+
+    // Acceleration of all particles (e.g. gravity) in pixels per second squared.
+    AnimatedValue<Offset> acceleration;
+
+    // Particle buffers (structure of arrays), all of the same length.
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> velocity_x;
+    std::vector<double> velocity_y;
+    std::vector<double> radius;
+    std::vector<Style> style;
+
+protected:
+    virtual double natural_width() const override;
+
+    virtual double natural_height() const override;
+
+private:
+    // Moves particles according to their velocities when the system is stepped.
+    class Integrator : public UpdatableValue
+    {
+    public:
+        explicit Integrator(ParticleSystem& system);
+
+        void step(double time_delta, StepID step_id) override;
+
+        Revision revision() const override;
+
+        void observe(const std::shared_ptr<ValueObserver>& observer) override;
+
+        bool is_settled() const override;
+
+        bool may_finish(double time_delta) const override;
+
+        // The state consists of the particle buffers.
+        std::unique_ptr<ValueState> save_state() const override;
+
+        void restore_state(const ValueState& state) override;
+
+        void invalidate();
+
+    private:
+        struct State;
+
+        ParticleSystem& system;
+        StepID next_step_id = 0;
+        Revision current_revision = 1;
+        ValueObservers observers;
+        bool moving = true;
+    };
+
+    Integrator integrator;
+    std::vector<Color> styles;
+};
+
+} // namespace Sian
+
+#endif
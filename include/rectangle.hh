@@ -19,12 +19,20 @@ public:
 
     virtual std::list<UpdatableValue*> animated_values() override;
 
+    virtual bool batchable() const override;
+
     AnimatedValue<double> width;
 
     AnimatedValue<double> height;
 
 protected:
-    virtual void push_context(DrawContext cr) const override;
+    virtual void build_path(DrawContext cr) const override;
+
+    virtual bool geometry(Fingerprint& fingerprint) const override;
+
+    virtual double effective_line_width() const override;
+
+    virtual cairo_line_join_t line_join() const override;
 
     virtual double natural_width() const override;
 
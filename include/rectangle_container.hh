@@ -5,6 +5,7 @@
 #include "object.hh"
 #include "rectangle.hh"
 
+#include <cstddef> // std::size_t
 #include <list>
 #include <memory>
 
@@ -19,8 +20,16 @@ public:
 
     virtual void draw(DrawContext cr) override;
 
+    virtual void layout() override;
+
     virtual std::list<UpdatableValue*> animated_values() override;
 
+    virtual bool is_visible() const override;
+
+    virtual bool batchable() const override;
+
+    virtual void appearance(Fingerprint& fingerprint) const override;
+
     AnimatedValue<double> padding;
 
 protected:
@@ -28,6 +37,10 @@ protected:
 
     double natural_height() const override;
 
+    virtual std::size_t child_count() const override;
+
+    virtual Object* nth_child(std::size_t i) const override;
+
 private:
     std::shared_ptr<Object> child;
 };
@@ -6,26 +6,81 @@
 
 #include <cairo.h>
 
+#include <cstddef> // std::size_t
 #include <initializer_list>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace Sian {
 
+class Layer;
+
+class SpatialGrid;
+class WorkerPool;
+
+// A scene, its Animator and its objects may be used by one thread at a time (apart from
+// the threads they start themselves). Several scenes can be rendered by different threads
+// at once, see BatchRunner, as long as they share no objects or animated values.
 class Scene
 {
 public:
     explicit Scene(const Config& config);
 
+    ~Scene();
+
     void add(std::shared_ptr<Object> object);
 
     void add(std::initializer_list<std::shared_ptr<Object>> new_objects);
 
     void add_show_creation(std::shared_ptr<Object> object);
 
+    // Takes the object out of the scene in constant (amortized) time. An object added
+    // more than once is removed from its first place in the drawing order.
+    void remove(std::shared_ptr<Object> object);
+
+    // Adds the object once the scene has been stepped to the given time (in seconds).
+    void add_at(double time, std::shared_ptr<Object> object);
+
+    // Removes the object once the scene has been stepped to the given time (in seconds).
+    void remove_at(double time, std::shared_ptr<Object> object);
+
+    // Time (in seconds) the scene has been stepped by so far.
+    double current_time() const;
+
+    // The background is drawn below all other objects. It is rendered only once
+    // and reused in the following snapshots until any of its values changes.
+    void set_background(std::shared_ptr<Object> background);
+
+    // Steps all objects that aren't sleeping. With more step threads in the config, objects whose
+    // values aren't connected are stepped in parallel, up to the first object whose values may
+    // finish their strategies (running actions, which may touch any other object); the rest is
+    // stepped in order. The result is the same as when stepping all objects in order, as long
+    // as stepping a value only reads values of the same object.
     void step(double time_delta);
 
+    // Saved state of the scene, see checkpoint().
+    struct Checkpoint;
+
+    // Captures the time, objects and planned events of the scene together with the states of
+    // all animated values of the objects. Checkpoints keep the objects alive.
+    std::shared_ptr<const Checkpoint> checkpoint();
+
+    // Brings the scene back to the checkpoint. Only what checkpoint() captures is restored:
+    // objects changed from outside of their animated values (e.g. children added to containers
+    // by actions) stay as they are.
+    void restore(const Checkpoint& checkpoint);
+
+    // Updates positions of objects inside containers and the transformations of all objects,
+    // recomputing only what has changed since the last call. The snapshots and record() call it
+    // themselves, so that they always draw the current state.
+    // It's const like the spatial index: the positions and transformations it updates are a cache
+    // derived from the animated values, so what the scene draws stays the same.
+    void layout() const;
+
     class Snapshot
     {
     public:
@@ -33,16 +88,202 @@ public:
 
         void save_png(std::string filename) const;
 
+        // Saves the snapshot as a PNG image compressed as the options say.
+        void save_png(std::string filename, const PngOptions& options) const;
+
+        // Saves the snapshot as a QOI image, which is much faster than PNG and usually
+        // only slightly larger.
+        void save_qoi(std::string filename) const;
+
+        // Encodes the snapshot as an image into out, replacing its content. The options only
+        // apply to PNG images.
+        void encode(
+                ImageFormat format,
+                const PngOptions& options,
+                std::vector<unsigned char>& out) const;
+
+        // Read-only view of the pixels of a snapshot. Copies of a snapshot share the
+        // pixels, which stay valid for as long as any of the copies exists. Pixels of
+        // snapshots drawn into a caller's buffer are only valid as long as the buffer is.
+        struct Pixels
+        {
+            const unsigned char* data;
+            // number of bytes between starts of two rows
+            int stride;
+            // ARGB32 or RGB24, both storing a pixel as a native-endian 32-bit word
+            cairo_format_t format;
+            int width;
+            int height;
+        };
+
+        Pixels pixels() const;
+
     private:
         std::shared_ptr<cairo_surface_t> surface;
     };
 
+    // Draws the scene in the resolution and quality given by the config.
     Snapshot snapshot() const;
 
+    // Draws the whole scene scaled to the given resolution (in pixels).
+    Snapshot snapshot(int width, int height, Quality quality) const;
+
+    // Draws the scene directly into a buffer owned by the caller, filling all of it. The buffer
+    // has to hold height rows of stride bytes, each pixel in the format of the quality profile.
+    // The returned snapshot only refers to the buffer, which must outlive it.
+    Snapshot snapshot_into(
+            unsigned char* data,
+            int stride,
+            int width,
+            int height,
+            Quality quality) const;
+
+    // Records drawing of the scene in its own coordinates, so that it can be replayed
+    // in several resolutions. Sprites and layers are rasterized in the resolution of the scene.
+    std::shared_ptr<cairo_surface_t> record() const;
+
+    // Draws a recording made by record() scaled to the given resolution (in pixels).
+    Snapshot replay(
+            std::shared_ptr<cairo_surface_t> recording,
+            int width,
+            int height,
+            Quality quality) const;
+
+    // Draws a recording made by record() into a buffer owned by the caller, like snapshot_into().
+    Snapshot replay_into(
+            std::shared_ptr<cairo_surface_t> recording,
+            unsigned char* data,
+            int stride,
+            int width,
+            int height,
+            Quality quality) const;
+
 private:
+    enum class EventType
+    {
+        ADD,
+        REMOVE
+    };
+
+    struct Event
+    {
+        EventType type;
+        std::shared_ptr<Object> object;
+    };
+
+    // Marks the object in a slot as changed, so that the spatial index updates it.
+    class SlotObserver;
+
+    // Steps the object unless it sleeps.
+    void step_object(std::size_t i, double time_delta);
+
+    // Steps objects in parallel while their order doesn't matter. Returns the number of leading
+    // objects stepped, the rest is left to be stepped in order.
+    std::size_t step_in_parallel(double time_delta, int threads);
+
+    // Groups objects whose values share any state into components, which are stepped by a single
+    // thread each.
+    void partition();
+
+    // Number of threads stepping the objects in step().
+    int step_thread_count() const;
+
+    void process_events();
+
+    // Drops the slots of removed objects, moving the objects after them.
+    void compact();
+
+    // Objects that are invisible and won't change by stepping are put to sleep.
+    // They are not stepped until any of their values changes.
+    void update_sleeping();
+
+    // Brings the spatial index up to date with the current state of objects.
+    void update_index() const;
+
+    // Forgets the content of the spatial index, e.g. when indices of objects changed.
+    void reset_index() const;
+
+    // Makes the object in the slot observed, so that its changes reach the spatial index.
+    void observe_slot(std::size_t i);
+
+    // Called by the observer of the slot, possibly from more threads.
+    void mark_changed(std::size_t i) const;
+
+    // Indices of objects that might be visible in the canvas, in drawing order.
+    const std::vector<std::size_t>& objects_on_canvas() const;
+
+    // Objects that might be visible in the canvas and would draw anything, in drawing order.
+    std::vector<Object*> visible_on_canvas() const;
+
+    // Number of threads drawing stripes of the canvas in snapshot().
+    int render_thread_count() const;
+
+    // Threads stepping objects and drawing stripes, started once needed.
+    WorkerPool& worker_pool() const;
+
+    // Draws a frame filling the whole buffer of the caller.
+    Snapshot draw_into(
+            unsigned char* data,
+            int stride,
+            int width,
+            int height,
+            const QualityProfile& profile,
+            cairo_surface_t* recording) const;
+
+    // Draws a frame into a new surface. Its dimensions are the given resolution, unless the
+    // profile keeps frames in its render scale. Replays the recording, if there is one.
+    std::shared_ptr<cairo_surface_t> draw_frame(
+            int width,
+            int height,
+            const QualityProfile& profile,
+            cairo_surface_t* recording) const;
+
+    // Draws a frame filling the whole target, drawn in the render scale of the profile
+    // and scaled up if the profile says so.
+    void draw_frame(
+            cairo_surface_t* target,
+            const QualityProfile& profile,
+            cairo_surface_t* recording) const;
+
+    // Draws a frame in the resolution of the target.
+    void draw_at_resolution(
+            cairo_surface_t* target,
+            const QualityProfile& profile,
+            cairo_surface_t* recording) const;
+
     Config config;
+    // in drawing order; removed objects leave empty slots until they make up half of them
     std::vector<std::shared_ptr<Object>> objects;
+    std::size_t removed_count = 0;
+    // where every object is, so that it can be removed without searching
+    std::unordered_multimap<const Object*, std::size_t> slots;
+    std::shared_ptr<Layer> background;
     StepID next_step_id;
+    double time;
+    std::multimap<double, Event> events;
+
+    // for every object, whether it is sleeping and its revision when it fell asleep
+    std::vector<bool> sleeping;
+    std::vector<Revision> sleep_revisions;
+
+    // indices of objects of every component in drawing order, unless the partition is outdated
+    std::vector<std::vector<std::size_t>> components;
+    // shared states of values of all objects when partitioned, those of the object i starting
+    // at partitioned_offsets[i]
+    std::vector<const void*> partitioned_states;
+    std::vector<std::size_t> partitioned_offsets;
+    bool partition_valid = false;
+
+    // the scene is used by one thread at a time, which takes part in the work of the pool
+    mutable std::unique_ptr<WorkerPool> workers;
+
+    mutable std::unique_ptr<SpatialGrid> index;
+    // observers of the objects, and slots of those changed since the index was updated
+    std::vector<std::shared_ptr<SlotObserver>> slot_observers;
+    mutable std::mutex changed_mutex;
+    mutable std::vector<std::size_t> changed_slots;
+    mutable std::vector<std::size_t> updated_slots;
+    mutable std::vector<std::size_t> visible_objects;
 };
 
 } // namespace Sian
@@ -0,0 +1,52 @@
+#ifndef SCRUB_CLIENT_HH
+#define SCRUB_CLIENT_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Sian {
+
+enum class ScrubFormat
+{
+    // rows of width native-endian 32-bit ARGB pixels, without any padding
+    RAW,
+    PNG,
+    QOI
+};
+
+// Asks an animation served by Animator::serve() for frames at any time.
+class ScrubClient
+{
+public:
+    // Throws std::runtime_error if the server cannot be reached.
+    explicit ScrubClient(const std::string& socket_path);
+
+    ScrubClient(const ScrubClient& other) = delete;
+
+    ~ScrubClient();
+
+    struct Frame
+    {
+        int width;
+        int height;
+        std::vector<unsigned char> data;
+    };
+
+    // Returns the frame closest to the time (in seconds) encoded in the format. Throws
+    // std::runtime_error with the message of the server if it cannot render the frame.
+    Frame frame(double time, ScrubFormat format);
+
+    // Makes the server stop once all other clients disconnect.
+    void stop_server();
+
+private:
+    void send_request(std::uint32_t type, ScrubFormat format, double time);
+
+    std::string socket_path;
+    int fd = -1;
+};
+
+} // namespace Sian
+
+#endif
@@ -2,13 +2,34 @@
 #define SHAPE_HH
 
 #include "animated_value.hh"
+#include "fingerprint.hh"
 #include "object.hh"
 #include "offset.hh"
 
+#include <cairo.h>
+
 #include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace Sian {
 
+// Everything that is set up in the drawing context before a shape is stroked.
+struct StrokeStyle
+{
+    double red;
+    double green;
+    double blue;
+    double alpha;
+    double line_width;
+    cairo_line_join_t line_join;
+
+    bool operator==(const StrokeStyle& other) const;
+
+    bool operator!=(const StrokeStyle& other) const;
+};
+
 class Shape : public Object
 {
 public:
@@ -18,10 +39,47 @@ public:
 
     virtual std::list<UpdatableValue*> animated_values() override;
 
+    virtual void appearance(Fingerprint& fingerprint) const override;
+
+    // Appends outline of the shape to the current path, in natural coordinates of the shape.
+    // The outline is built only when the geometry of the shape changes, otherwise a copy
+    // of the previous outline is reused.
+    void append_path(DrawContext cr) const;
+
+    // Returns true if drawing the shape consists only of stroking the path from append_path()
+    // with its stroke_style(), so that it can be stroked together with other shapes.
+    virtual bool batchable() const;
+
+    StrokeStyle stroke_style() const;
+
+    // Strokes outlines of all the shapes at once. All of them must be batchable and share
+    // the same stroke style.
+    static void draw_batch(DrawContext cr, const std::vector<Shape*>& shapes);
+
     AnimatedValue<double> line_width;
 
 protected:
     virtual void push_context(DrawContext cr) const override;
+
+    // Builds outline of the shape in the current path, in natural coordinates of the shape.
+    virtual void build_path(DrawContext cr) const;
+
+    // Adds all values that affect the outline to the fingerprint. Returns false if
+    // the outline shouldn't be cached.
+    virtual bool geometry(Fingerprint& fingerprint) const;
+
+    // Line width actually used for stroking, which might be limited by dimensions of the shape.
+    virtual double effective_line_width() const;
+
+    virtual cairo_line_join_t line_join() const;
+
+    // Batching is only possible when the line width isn't distorted by scaling.
+    bool uniformly_scaled() const;
+
+private:
+    mutable std::shared_ptr<cairo_path_t> cached_path;
+    mutable Fingerprint cached_geometry;
+    mutable std::mutex path_mutex;
 };
 
 } // namespace Sian
@@ -0,0 +1,68 @@
+#ifndef SHARED_MEMORY_RING_READER_HH
+#define SHARED_MEMORY_RING_READER_HH
+
+#include <cairo.h>
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Sian {
+
+// Consumer side of SharedMemoryRingSink, meant to be used by another process.
+class SharedMemoryRingReader
+{
+public:
+    struct FrameInfo
+    {
+        // index of the frame in the animation
+        std::uint64_t frame;
+        // time of the frame in the animation
+        std::uint64_t presentation_time_ns;
+        // std::chrono::steady_clock time when the frame was published
+        std::uint64_t publish_time_ns;
+        int width;
+        int height;
+        int stride;
+        cairo_format_t format;
+    };
+
+    // Throws std::runtime_error if the producer hasn't created the ring yet.
+    explicit SharedMemoryRingReader(const std::string& name);
+
+    SharedMemoryRingReader(const SharedMemoryRingReader& other) = delete;
+
+    ~SharedMemoryRingReader();
+
+    // Copies the oldest unread frame that is still in the ring into pixels.
+    // Returns false if there is no such frame yet.
+    bool read(std::vector<unsigned char>& pixels, FrameInfo& info);
+
+    // Gives access to the oldest unread frame without copying it. The frame stays valid until
+    // release() is called. Only possible when the producer blocks on overflow, otherwise the
+    // frame could be overwritten in the meantime. Returns nullptr if there is no frame yet.
+    const unsigned char* acquire(FrameInfo& info);
+
+    void release();
+
+    // Returns true once the producer has finished and all of its frames have been read.
+    bool finished() const;
+
+    // Number of frames overwritten by the producer before they could be read.
+    std::uint64_t dropped_frames() const;
+
+private:
+    void fill_info(std::uint64_t frame, FrameInfo& info) const;
+
+    int fd = -1;
+    void* memory = nullptr;
+    std::size_t size = 0;
+    std::uint64_t next_frame = 0;
+    std::uint64_t dropped = 0;
+    bool acquired = false;
+};
+
+} // namespace Sian
+
+#endif
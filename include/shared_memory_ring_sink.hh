@@ -0,0 +1,72 @@
+#ifndef SHARED_MEMORY_RING_SINK_HH
+#define SHARED_MEMORY_RING_SINK_HH
+
+#include "frame_sink.hh"
+#include "scene.hh"
+
+#include <cairo.h>
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <string>
+
+namespace Sian {
+
+// What the producer does when all slots of the ring hold frames the consumer hasn't read yet.
+enum class RingOverflow
+{
+    // wait until the consumer reads a frame
+    BLOCK,
+    // overwrite the oldest frame
+    DROP_OLDEST
+};
+
+// Publishes frames into a ring of slots in POSIX shared memory, to be read by a single consumer
+// process on the same host using SharedMemoryRingReader. Frames are drawn directly into the slots.
+// The shared memory object (named like "/sian") is created with the first frame, once dimensions
+// of frames are known, and removed when the sink is destroyed.
+class SharedMemoryRingSink : public FrameSink
+{
+public:
+    SharedMemoryRingSink(
+            const std::string& name,
+            double fps,
+            int slot_count = 4,
+            RingOverflow overflow = RingOverflow::BLOCK);
+
+    virtual ~SharedMemoryRingSink();
+
+    virtual unsigned char* frame_buffer(
+            int width,
+            int height,
+            cairo_format_t format,
+            int& stride) override;
+
+    virtual void write(const Scene::Snapshot& frame) override;
+
+    virtual void finish() override;
+
+private:
+    void open(int width, int height, cairo_format_t format);
+
+    // Claims the slot for the next frame, waiting for the consumer if the overflow policy says so.
+    unsigned char* begin_frame();
+
+    void close();
+
+    std::string name;
+    double fps;
+    int slot_count;
+    RingOverflow overflow;
+
+    int fd = -1;
+    void* memory = nullptr;
+    std::size_t size = 0;
+    std::uint64_t next_frame = 0;
+    // whether the slot of next_frame has been claimed
+    bool frame_begun = false;
+};
+
+} // namespace Sian
+
+#endif
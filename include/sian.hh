@@ -3,10 +3,21 @@
 
 #include "animated_value.hh"
 #include "animator.hh"
+#include "batch_runner.hh"
 #include "color.hh"
 #include "config.hh"
+#include "ffmpeg_stream_sink.hh"
+#include "frame_archive_reader.hh"
+#include "frame_archive_sink.hh"
+#include "frame_sink.hh"
+#include "gif_sink.hh"
+#include "image_sequence_sink.hh"
 #include "object.hh"
 #include "offset.hh"
 #include "scene.hh"
+#include "scrub_client.hh"
+#include "shared_memory_ring_reader.hh"
+#include "shared_memory_ring_sink.hh"
+#include "yuv.hh"
 
 #endif
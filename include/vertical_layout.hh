@@ -0,0 +1,28 @@
+#ifndef VERTICAL_LAYOUT_HH
+#define VERTICAL_LAYOUT_HH
+
+#include "layout.hh"
+#include "object.hh"
+#include "offset.hh"
+
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace Sian {
+
+// Places children in a column, aligned to the left.
+class VerticalLayout : public Layout
+{
+public:
+    VerticalLayout(
+            const Offset& center,
+            std::initializer_list<std::shared_ptr<Object>> children);
+
+protected:
+    virtual void arrange(std::vector<Slot>& slots, double& width, double& height) const override;
+};
+
+} // namespace Sian
+
+#endif
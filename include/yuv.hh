@@ -0,0 +1,33 @@
+#ifndef YUV_HH
+#define YUV_HH
+
+#include <cstddef> // std::size_t
+
+namespace Sian {
+
+// Layout of chroma planes of a YUV 4:2:0 frame. I420 stores U and V in separate
+// planes, NV12 in a single plane with interleaved U and V samples.
+enum class ChromaLayout
+{
+    I420,
+    NV12
+};
+
+// Number of bytes taken by a YUV 4:2:0 frame of the given dimensions.
+std::size_t yuv420_size(int width, int height);
+
+// Converts ARGB32 pixels (premultiplied, as drawn by cairo) to YUV 4:2:0 with BT.601 limited
+// range. Premultiplied colors are the colors composited over black, so no unpremultiplying is
+// needed. The output consists of the luma plane followed by the chroma plane(s), every chroma
+// sample being the average of a 2x2 block of pixels. Uses AVX2 or SSE4.1 when available.
+void argb_to_yuv420(
+        const unsigned char* argb,
+        int stride,
+        int width,
+        int height,
+        ChromaLayout layout,
+        unsigned char* out);
+
+} // namespace Sian
+
+#endif
@@ -7,6 +7,8 @@
 #include "offset.hh"
 #include "utils.hh"
 
+#include <algorithm> // std::max
+#include <cstddef> // std::size_t
 #include <cstdint> // std::uint64_t
 #include <functional>
 #include <memory>
@@ -14,9 +16,55 @@
 #include <queue>
 #include <stdexcept>
 #include <utility> // std::move
+#include <vector>
 
 namespace Sian {
 
+ValueObserver::~ValueObserver()
+{ }
+
+void ValueObservers::add(const std::shared_ptr<ValueObserver>& observer)
+{
+    for (const auto& present : observers)
+    {
+        if (!present.owner_before(observer) && !observer.owner_before(present))
+            return;
+    }
+    observers.push_back(observer);
+}
+
+void ValueObservers::merge(const ValueObservers& other)
+{
+    for (const auto& observer : other.observers)
+    {
+        if (const auto alive = observer.lock())
+            add(alive);
+    }
+}
+
+void ValueObservers::notify()
+{
+    for (std::size_t i = 0; i < observers.size(); )
+    {
+        if (const auto observer = observers[i].lock())
+        {
+            observer->value_changed();
+            ++i;
+        }
+        else
+        {
+            // order of notifications doesn't matter
+            observers[i] = std::move(observers.back());
+            observers.pop_back();
+        }
+    }
+}
+
+const void* UpdatableValue::shared_state() const
+{
+    return this;
+}
+
 template<typename T>
 struct AnimatedValue<T>::Data
 {
@@ -24,9 +72,19 @@ struct AnimatedValue<T>::Data
     std::queue<std::unique_ptr<Instruction<T>>> instructions_queue;
     std::vector<std::weak_ptr<DataWrapper>> connected_wrappers;
     StepID next_step_id = 0;
+    Revision revision = 0;
+    ValueObservers observers;
+
+    // Has to be called whenever the value may change.
+    void touch()
+    {
+        ++revision;
+        observers.notify();
+    }
 
     void interpret_instruction(std::unique_ptr<Instruction<T>>&& instr)
     {
+        touch();
         switch (instr->strategy_type())
         {
             case StrategyType::ANIMATION:
@@ -71,6 +129,7 @@ struct AnimatedValue<T>::Data
 
     void set_const(const T& value)
     {
+        touch();
         strategy = std::make_unique<FunctionStrategy<T>>(
                 std::make_unique<ConstantInstruction<T>>(value));
     }
@@ -81,6 +140,10 @@ struct AnimatedValue<T>::Data
             return;
         next_step_id = step_id + 1;
 
+        // constant strategies keep their value until they are replaced
+        if (strategy->type() != StrategyType::CONSTANT)
+            touch();
+
         while (time_delta > 0)
         {
             double time_used = strategy->step(time_delta);
@@ -114,6 +177,14 @@ struct AnimatedValue<T>::DataWrapper
     ValueConvertor to_data;
 };
 
+template<typename T>
+struct AnimatedValue<T>::State : public ValueState
+{
+    // values connected after the state was saved keep their new data
+    std::shared_ptr<Data> data;
+    std::unique_ptr<DynamicValueStrategy<T>> strategy;
+    std::vector<std::unique_ptr<Instruction<T>>> instructions;
+};
 
 template<typename T>
 AnimatedValue<T>::AnimatedValue(const T& value)
@@ -293,7 +364,10 @@ auto AnimatedValue<T>::connect(const AnimatedValue<T>& other,
         throw std::logic_error("Can't connect animated values that have "
                                "already been (even indirectly) connected.");
     }
-    for (const auto& sibling_weak_ptr : data_wrapper->data->connected_wrappers)
+    // revisions of the siblings must not decrease by switching to other's data
+    const std::shared_ptr<Data> old_data = data();
+    other.data()->revision = std::max(old_data->revision, other.data()->revision);
+    for (const auto& sibling_weak_ptr : old_data->connected_wrappers)
     {
         const auto sibling_wrapper = sibling_weak_ptr.lock();
         if (!sibling_wrapper)
@@ -314,6 +388,8 @@ auto AnimatedValue<T>::connect(const AnimatedValue<T>& other,
         sibling_wrapper->data->connected_wrappers.push_back(
                     std::weak_ptr<DataWrapper>(sibling_wrapper));
     }
+    other.data()->observers.merge(old_data->observers);
+    other.data()->touch();
     return *this;
 }
 
@@ -338,6 +414,71 @@ void AnimatedValue<T>::step(double time_delta, StepID step_id)
     data()->step(time_delta, step_id);
 }
 
+template<typename T>
+Revision AnimatedValue<T>::revision() const
+{
+    return data()->revision;
+}
+
+template<typename T>
+void AnimatedValue<T>::observe(const std::shared_ptr<ValueObserver>& observer)
+{
+    data()->observers.add(observer);
+}
+
+template<typename T>
+bool AnimatedValue<T>::is_settled() const
+{
+    const auto& strategy = data()->strategy;
+    return strategy->type() == StrategyType::CONSTANT &&
+           !strategy->is_finite() &&
+           data()->instructions_queue.empty();
+}
+
+template<typename T>
+bool AnimatedValue<T>::may_finish(double time_delta) const
+{
+    return data()->strategy->finishes_within(time_delta);
+}
+
+template<typename T>
+const void* AnimatedValue<T>::shared_state() const
+{
+    return data().get();
+}
+
+template<typename T>
+std::unique_ptr<ValueState> AnimatedValue<T>::save_state() const
+{
+    auto state = std::make_unique<State>();
+    state->data = data();
+    state->strategy = data()->strategy->clone();
+
+    // the queue can only be walked through by rotating it
+    auto& queue = data()->instructions_queue;
+    for (std::size_t i = 0; i < queue.size(); ++i)
+    {
+        state->instructions.push_back(queue.front()->clone());
+        queue.push(std::move(queue.front()));
+        queue.pop();
+    }
+    return state;
+}
+
+template<typename T>
+void AnimatedValue<T>::restore_state(const ValueState& state)
+{
+    const State& saved = dynamic_cast<const State&>(state);
+    Data& target = *saved.data;
+    target.strategy = saved.strategy->clone();
+    target.instructions_queue = { };
+    for (const auto& instruction : saved.instructions)
+    {
+        target.instructions_queue.push(instruction->clone());
+    }
+    target.touch();
+}
+
 template<typename T>
 auto AnimatedValue<T>::data() -> std::shared_ptr<Data>&
 {
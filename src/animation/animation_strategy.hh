@@ -27,15 +27,27 @@ public:
           instr_data(std::move(instr_data))
     { }
 
+    AnimationStrategy(const AnimationStrategy<T>& other)
+        : elapsed(other.elapsed),
+          origin(other.origin),
+          duration(other.duration),
+          instr_data(std::make_unique<AnimationInstruction<T>>(*other.instr_data))
+    { }
+
     bool is_finite() const override
     {
         return true;
     }
 
+    bool finishes_within(double time_delta) const override
+    {
+        return elapsed + time_delta >= duration;
+    }
+
     double step(double time_delta) override
     {
         double time_used;
-        if (elapsed + time_delta >= duration)
+        if (finishes_within(time_delta))
         {
             time_used = duration - elapsed;
             elapsed = duration;
@@ -61,6 +73,11 @@ public:
         return StrategyType::ANIMATION;
     }
 
+    std::unique_ptr<DynamicValueStrategy<T>> clone() const override
+    {
+        return std::make_unique<AnimationStrategy<T>>(*this);
+    }
+
     void add_action(std::function<void()> action) override
     {
         instr_data->add_action(action);
@@ -21,8 +21,14 @@ public:
 
     virtual bool is_finite() const = 0;
 
+    // Returns true if step(time_delta) would finish the strategy.
+    virtual bool finishes_within(double time_delta) const = 0;
+
     virtual StrategyType type() const = 0;
 
+    // Copies the strategy in its current state, including actions of its instruction.
+    virtual std::unique_ptr<DynamicValueStrategy<T>> clone() const = 0;
+
     virtual void add_action(std::function<void()> action)
     {
         action();
@@ -3,6 +3,7 @@
 
 #include "dynamic_value_strategy.hh"
 #include "instruction.hh"
+#include "utils.hh"
 
 #include <cmath>
 #include <memory>
@@ -18,6 +19,12 @@ public:
         : instr_data(std::move(instr_data))
     { }
 
+    FunctionStrategy(const FunctionStrategy<T>& other)
+        : relative_time(other.relative_time),
+          instr_data(Utils::dynamic_pointer_cast<FunctionInstruction<T>>(
+                  other.instr_data->clone()))
+    { }
+
     double step(double time_delta) override
     {
         if (!is_finite())
@@ -34,6 +41,12 @@ public:
         return time_used;
     }
 
+    bool finishes_within(double time_delta) const override
+    {
+        // the same comparison as in step()
+        return is_finite() && instr_data->timeout - relative_time < time_delta;
+    }
+
     T get() const override
     {
         return instr_data->value_supplier(relative_time);
@@ -46,7 +59,13 @@ public:
 
     StrategyType type() const override
     {
-        return StrategyType::FUNCTION;
+        // constant values are function strategies too
+        return instr_data->strategy_type();
+    }
+
+    std::unique_ptr<DynamicValueStrategy<T>> clone() const override
+    {
+        return std::make_unique<FunctionStrategy<T>>(*this);
     }
 
     void add_action(std::function<void()> action) override
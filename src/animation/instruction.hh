@@ -4,6 +4,7 @@
 #include "pace_value.hh"
 
 #include <functional>
+#include <memory>
 #include <vector>
 
 namespace Sian {
@@ -25,8 +26,14 @@ template<typename T>
 class Instruction
 {
 public:
+    virtual ~Instruction()
+    { }
+
     virtual StrategyType strategy_type() const = 0;
 
+    // Copies the instruction together with its pending actions.
+    virtual std::unique_ptr<Instruction<T>> clone() const = 0;
+
     template<typename F>
     void add_action(const F& action)
     {
@@ -60,6 +67,11 @@ public:
         return StrategyType::ANIMATION;
     }
 
+    std::unique_ptr<Instruction<T>> clone() const override
+    {
+        return std::make_unique<AnimationInstruction<T>>(*this);
+    }
+
     const T target;
     const PaceValueType value_type;
     const double value;
@@ -89,6 +101,11 @@ public:
         return StrategyType::FUNCTION;
     }
 
+    std::unique_ptr<Instruction<T>> clone() const override
+    {
+        return std::make_unique<FunctionInstruction<T>>(*this);
+    }
+
     const ValueSupplier<T> value_supplier;
     const TimeoutType timeout_type;
     const double timeout;
@@ -110,6 +127,11 @@ public:
     {
         return StrategyType::CONSTANT;
     }
+
+    std::unique_ptr<Instruction<T>> clone() const override
+    {
+        return std::make_unique<ConstantInstruction<T>>(*this);
+    }
 };
 
 } // namespace Sian
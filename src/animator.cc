@@ -1,54 +1,103 @@
 #include "animator.hh"
+#include "ffmpeg_stream_sink.hh"
+#include "frame_archive_sink.hh"
+#include "frame_sink.hh"
+#include "gif_sink.hh"
+#include "image_sequence_sink.hh"
 #include "logger.hh"
+#include "scrub/scrub_server.hh"
 #include "utils.hh"
 
-#include <cstdlib> // std::system
-#include <sstream>
-#include <stdexcept> // std::invalid_argument
+#include <cairo.h>
+
+#include <algorithm> // std::max, std::min
+#include <cmath> // std::lround
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
 #include <string>
-#include <sys/types.h>
-#include <sys/stat.h>
+#include <vector>
 
 namespace Sian {
 
-void setup(const Config& config)
-{
-    const std::string dir = config.temporary_directory;
+namespace {
 
-    struct stat info;
-    if (stat(dir.c_str(), &info) != 0 || !(info.st_mode & S_IFDIR))
-    {
-        throw std::invalid_argument(Utils::str_format(
-                "Cannot access directory %s/. Please make sure it exists.",
-                dir.c_str()));
-    }
+std::shared_ptr<FrameSink> default_sink(const Config& config)
+{
+    if (config.gif_output)
+        return std::make_shared<GifSink>(config);
+    if (config.stream_output)
+        return std::make_shared<FfmpegStreamSink>(config);
+    if (!config.frame_archive.empty())
+        return std::make_shared<FrameArchiveSink>(config);
+    return std::make_shared<ImageSequenceSink>(config);
 }
 
+} // namespace Sian::{anonymous}
+
 Animator::Animator(const Config& config, Scene& scene)
-    : config(config), scene(scene), time(0)
+    : Animator(
+            config,
+            scene,
+            {{
+                config.main_scene_width,
+                config.main_scene_height,
+                config.quality,
+                default_sink(config)
+            }})
+{ }
+
+Animator::Animator(const Config& config, Scene& scene, std::vector<OutputTarget> targets)
+    : config(config), scene(scene), time(0), targets(targets)
 {
-    setup(config);
+    if (this->targets.empty())
+        throw std::invalid_argument("Animator needs at least one output target.");
 }
 
 void Animator::step()
 {
-    const std::string filename = config.temporary_directory + "/" +
-                                 std::to_string(output_counter++) + ".png";
+    if (!resumed)
+        resume();
+    keep_checkpoint();
+    if (frame < resume_frame)
+    {
+        advance();
+        return;
+    }
+
+    std::shared_ptr<cairo_surface_t> recording;
+    if (shared_recording && targets.size() > 1)
+        recording = scene.record();
 
-    struct stat info;
-    if (stat(filename.c_str(), &info) == 0 && config.require_empty_tmp_dir)
+    for (const OutputTarget& target : targets)
     {
-        throw std::invalid_argument(Utils::str_format(
-                "The temporary directory %s/ is not empty. Please remove its content or "
-                "run the program with -r option to state that you wish to do it automatically.",
-                config.temporary_directory.c_str()));
+        // frames are drawn directly into the memory of the sink, if it offers any
+        const QualityProfile profile = QualityProfile::of(target.quality);
+        const int width = profile.frame_dimension(target.width);
+        const int height = profile.frame_dimension(target.height);
+        int stride = 0;
+        unsigned char* buffer = target.sink->frame_buffer(width, height, profile.format, stride);
+
+        if (buffer && recording)
+            target.sink->write(scene.replay_into(recording, buffer, stride, width, height, target.quality));
+        else if (buffer)
+            target.sink->write(scene.snapshot_into(buffer, stride, width, height, target.quality));
+        else if (recording)
+            target.sink->write(scene.replay(recording, target.width, target.height, target.quality));
+        else
+            target.sink->write(scene.snapshot(target.width, target.height, target.quality));
     }
 
-    scene.snapshot().save_png(filename);
+    advance();
+}
 
+void Animator::advance()
+{
     const double delta = 1 / config.fps;
     scene.step(delta);
     time += delta;
+    ++frame;
 
     for (const TickObserver& observer : tick_observers)
     {
@@ -65,38 +114,141 @@ void Animator::wait(double duration)
     }
 }
 
+void Animator::seek(double time)
+{
+    if (time < 0)
+        throw std::invalid_argument("Cannot seek to a negative time.");
+    const long target = std::lround(time * config.fps);
+
+    auto it = checkpoints.upper_bound(target);
+    if (it != checkpoints.begin())
+    {
+        --it;
+        // stepping from the current frame is cheaper unless it's past the target or further
+        if (target < frame || it->first > frame)
+        {
+            scene.restore(*it->second.scene);
+            this->time = it->second.time;
+            frame = it->first;
+        }
+    }
+    if (target < frame)
+    {
+        throw std::logic_error(Utils::str_format(
+                "Cannot seek back to %g s, no checkpoint has been kept before it.", time));
+    }
+
+    while (frame < target)
+    {
+        keep_checkpoint();
+        advance();
+    }
+}
+
+void Animator::set_checkpoint_interval(double interval)
+{
+    if (interval < 0)
+        throw std::invalid_argument("Interval between checkpoints cannot be negative.");
+    checkpoint_period = interval > 0 ? std::max(1L, std::lround(interval * config.fps)) : 0;
+}
+
+void Animator::set_checkpoint_limit(std::size_t count)
+{
+    if (count == 0)
+        throw std::invalid_argument("At least one checkpoint has to be allowed.");
+    checkpoint_limit = count;
+}
+
+void Animator::clear_checkpoints()
+{
+    checkpoints.clear();
+}
+
+void Animator::serve(
+        const std::string& socket_path,
+        double duration,
+        int workers,
+        std::size_t cached_frames)
+{
+    if (!(duration >= 0))
+        throw std::invalid_argument("Duration of the timeline cannot be negative.");
+    if (checkpoint_period == 0)
+        set_checkpoint_interval(1.0);
+
+    const OutputTarget target = targets.front();
+    ScrubServer server(
+            socket_path,
+            config.fps,
+            std::lround(duration * config.fps),
+            workers,
+            cached_frames,
+            config.png_options,
+            [this, target] (long frame)
+            {
+                seek(frame / config.fps);
+                return scene.snapshot(target.width, target.height, target.quality);
+            });
+    server.run();
+}
+
+void Animator::resume()
+{
+    resumed = true;
+    for (const OutputTarget& target : targets)
+    {
+        target.sink->set_render_settings({target.width, target.height, target.quality, config.fps});
+    }
+    if (!config.resume)
+        return;
+
+    std::uint64_t count = targets.front().sink->completed_frames();
+    for (const OutputTarget& target : targets)
+    {
+        count = std::min(count, target.sink->completed_frames());
+    }
+    for (const OutputTarget& target : targets)
+    {
+        target.sink->skip_frames(count);
+    }
+    resume_frame = frame + count;
+    Logger::info(Utils::str_format(
+            "Resuming the render by frame %llu.", (unsigned long long) count));
+}
+
+void Animator::keep_checkpoint()
+{
+    if (checkpoint_period == 0 || frame % checkpoint_period != 0 || checkpoints.count(frame))
+        return;
+    checkpoints[frame] = {time, scene.checkpoint()};
+
+    while (checkpoints.size() > checkpoint_limit)
+    {
+        checkpoint_period *= 2;
+        for (auto it = checkpoints.begin(); it != checkpoints.end();)
+        {
+            if (it->first % checkpoint_period != 0)
+                it = checkpoints.erase(it);
+            else
+                ++it;
+        }
+    }
+}
+
 void Animator::register_tick_observer(const TickObserver& observer)
 {
     tick_observers.push_back(observer);
 }
 
-std::string output_filename(const Config& conf)
+void Animator::set_shared_recording(bool enabled)
 {
-    const std::string fn = conf.output_file;
-    const std::string ext = std::string(".mp4");
-    // for any filename that doesn't end with '.mp4'
-    // or is equal to '.mp4', we append '.mp4'
-    if (fn.size() < ext.size() + 1 ||
-        fn.compare(fn.size() - ext.size(), ext.size(), ext) != 0)
-        return fn + ext;
-    return fn;
+    shared_recording = enabled;
 }
 
-
 void Animator::finish()
 {
-    const std::string output = output_filename(config);
-    if (system(NULL) != 0)
+    for (const OutputTarget& target : targets)
     {
-        std::ostringstream ss;
-        ss << "ffmpeg -r "
-           << std::to_string(config.fps)
-           << " -f image2 -i "
-           << config.temporary_directory
-           << "/%d.png -vcodec libx264 -crf 25 -pix_fmt yuv420p "
-           << output;
-        Logger::info(ss.str());
-        std::system(ss.str().c_str());
+        target.sink->finish();
     }
 }
 
@@ -0,0 +1,113 @@
+#include "animator.hh"
+#include "batch_runner.hh"
+#include "config.hh"
+#include "logger.hh"
+#include "scene.hh"
+#include "utils.hh"
+
+#include <algorithm> // std::max, std::min
+#include <atomic>
+#include <cstddef> // std::size_t
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Sian {
+
+namespace {
+
+// Paths an animation writes into, which no other animation may use at once.
+std::vector<std::string> exclusive_paths(const Config& config)
+{
+    std::vector<std::string> paths = {config.output_file};
+    if (!config.frame_archive.empty())
+        paths.push_back(config.frame_archive);
+    else if (!config.gif_output)
+        paths.push_back(config.temporary_directory);
+    return paths;
+}
+
+} // namespace Sian::{anonymous}
+
+BatchRunner::BatchRunner(int threads)
+    : threads(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{ }
+
+void BatchRunner::add(const std::string& name, const Config& config, const Script& script)
+{
+    for (const std::string& path : exclusive_paths(config))
+    {
+        for (const Job& job : jobs)
+        {
+            for (const std::string& other_path : exclusive_paths(job.config))
+            {
+                if (path == other_path)
+                {
+                    throw std::invalid_argument(Utils::str_format(
+                            "Animations %s and %s cannot both write into %s.",
+                            job.name.c_str(), name.c_str(), path.c_str()));
+                }
+            }
+        }
+    }
+    jobs.push_back({name, config, script});
+}
+
+void BatchRunner::run()
+{
+    std::vector<unsigned char> failed_jobs(jobs.size(), 0);
+    std::atomic<std::size_t> next_job(0);
+    auto worker = [&]()
+    {
+        for (std::size_t j = next_job++; j < jobs.size(); j = next_job++)
+        {
+            const Job& job = jobs[j];
+            try
+            {
+                Scene scene(job.config);
+                Animator animator(job.config, scene);
+                job.script(scene, animator);
+                animator.finish();
+            }
+            catch (const std::exception& e)
+            {
+                failed_jobs[j] = true;
+                Logger::error(Utils::str_format(
+                        "Animation %s has failed: %s", job.name.c_str(), e.what()));
+            }
+            catch (...)
+            {
+                failed_jobs[j] = true;
+                Logger::error(Utils::str_format("Animation %s has failed.", job.name.c_str()));
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    const int count = std::min<std::size_t>(threads, jobs.size());
+    for (int t = 1; t < count; ++t)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& w : workers)
+    {
+        w.join();
+    }
+
+    std::string failed;
+    for (std::size_t j = 0; j < jobs.size(); ++j)
+    {
+        if (failed_jobs[j])
+            failed += (failed.empty() ? "" : ", ") + jobs[j].name;
+    }
+    if (!failed.empty())
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Some animations have failed: %s", failed.c_str()));
+    }
+}
+
+} // namespace Sian
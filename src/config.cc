@@ -2,6 +2,7 @@
 #include "logger.hh"
 #include "utils.hh"
 
+#include <cmath> // std::ceil
 #include <cstdlib> // std::exit
 #include <functional>
 #include <iostream>
@@ -18,9 +19,95 @@ Config::Config()
       fps(30),
       temporary_directory("pngs"),
       output_file("anim"),
-      require_empty_tmp_dir(true)
+      require_empty_tmp_dir(true),
+      cull_offscreen(true),
+      batch_strokes(false),
+      sprite_memory_budget(256),
+      render_threads(1),
+      step_threads(1),
+      quality(Quality::FINAL),
+      image_format(ImageFormat::PNG),
+      png_options(),
+      writer_options(),
+      gif_output(false),
+      stream_output(false),
+      frame_archive(""),
+      resume(false),
+      scrub_socket("")
 { }
 
+QualityProfile QualityProfile::of(Quality quality)
+{
+    switch (quality)
+    {
+    case Quality::DRAFT:
+        return {CAIRO_ANTIALIAS_NONE, 0.5, false, CAIRO_FORMAT_RGB24, 1.0};
+    case Quality::PREVIEW:
+        return {CAIRO_ANTIALIAS_FAST, 0.5, true, CAIRO_FORMAT_RGB24, 0.5};
+    case Quality::FINAL:
+        return {CAIRO_ANTIALIAS_BEST, 1.0, false, CAIRO_FORMAT_ARGB32, 0.1};
+    }
+    throw std::invalid_argument("unknown quality");
+}
+
+int QualityProfile::frame_dimension(int output_dimension) const
+{
+    // frames drawn at a lower resolution are either scaled back up, or kept that way
+    if (upscale)
+        return output_dimension;
+    return (int) std::ceil(output_dimension * render_scale);
+}
+
+QualityProfile Config::quality_profile() const
+{
+    return QualityProfile::of(quality);
+}
+
+Quality parse_quality(const std::string& name)
+{
+    if (name == "draft")
+        return Quality::DRAFT;
+    if (name == "preview")
+        return Quality::PREVIEW;
+    if (name == "final")
+        return Quality::FINAL;
+    throw std::invalid_argument(Utils::str_format("unknown quality: \"%s\"", name.c_str()));
+}
+
+ImageFormat parse_image_format(const std::string& name)
+{
+    if (name == "png")
+        return ImageFormat::PNG;
+    if (name == "qoi")
+        return ImageFormat::QOI;
+    throw std::invalid_argument(Utils::str_format("unknown image format: \"%s\"", name.c_str()));
+}
+
+PngFilter parse_png_filter(const std::string& name)
+{
+    if (name == "none")
+        return PngFilter::NONE;
+    if (name == "sub")
+        return PngFilter::SUB;
+    if (name == "up")
+        return PngFilter::UP;
+    if (name == "average")
+        return PngFilter::AVERAGE;
+    if (name == "paeth")
+        return PngFilter::PAETH;
+    if (name == "adaptive")
+        return PngFilter::ADAPTIVE;
+    throw std::invalid_argument(Utils::str_format("unknown PNG filter: \"%s\"", name.c_str()));
+}
+
+int parse_compression_level(const std::string& value)
+{
+    const int level = std::stoi(value);
+    if (level < 0 || level > 9)
+        throw std::invalid_argument("compression level out of range");
+    return level;
+}
+
 struct Item
 {
     std::vector<std::string> names;
@@ -73,6 +160,115 @@ const std::vector<Item> configurable_items =
         "If present, files in the directory used for placing temporary files will be overriden.",
         [](Config& c, const std::string& val) { c.require_empty_tmp_dir = false; },
         false
+    },
+    {
+        {"n", "nocull"},
+        "If present, all objects are drawn, even those lying completely outside of the canvas.",
+        [](Config& c, const std::string& val) { c.cull_offscreen = false; },
+        false
+    },
+    {
+        {"b", "batch"},
+        "If present, neighbouring shapes sharing the same stroke style are stroked at once. "
+        "This is faster, but overlapping shapes may differ slightly in antialiasing.",
+        [](Config& c, const std::string& val) { c.batch_strokes = true; },
+        false
+    },
+    {
+        {"s", "sprites"},
+        "Set how many megabytes can be taken by cached sprites of all objects of the process.",
+        [](Config& c, const std::string& val) { c.sprite_memory_budget = std::stoi(val); }
+    },
+    {
+        {"t", "threads"},
+        "Set how many threads draw each frame, every one of them a different horizontal stripe. "
+        "With 0, one thread per processor core is used.",
+        [](Config& c, const std::string& val) { c.render_threads = std::stoi(val); }
+    },
+    {
+        {"k", "step-threads"},
+        "Set how many threads step the objects of the scene, every one of them different groups "
+        "of objects whose values aren't connected. With 0, one thread per processor core is used.",
+        [](Config& c, const std::string& val) { c.step_threads = std::stoi(val); }
+    },
+    {
+        {"q", "quality"},
+        "Set quality of rendering: draft (half resolution, no antialiasing), preview (drawn at half "
+        "resolution and scaled up) or final (the default).",
+        [](Config& c, const std::string& val) { c.quality = parse_quality(val); }
+    },
+    {
+        {"i", "images"},
+        "Set format of the images in the directory for temporary files: png (the default) or qoi "
+        "(much faster to write, needs FFmpeg 5.1 or newer).",
+        [](Config& c, const std::string& val) { c.image_format = parse_image_format(val); }
+    },
+    {
+        {"c", "compression"},
+        "Set how much PNG images are compressed, from 0 (fastest) to 9 (smallest). Levels 0 and 1 "
+        "suit temporary images, the default is 6.",
+        [](Config& c, const std::string& val)
+        {
+            c.png_options.compression_level = parse_compression_level(val);
+        }
+    },
+    {
+        {"p", "filter"},
+        "Set the filter applied to rows of PNG images: none, sub, up, average, paeth or adaptive "
+        "(the default, choosing the best filter for every row, which is slower but gives smaller "
+        "images).",
+        [](Config& c, const std::string& val) { c.png_options.filter = parse_png_filter(val); }
+    },
+    {
+        {"j", "writers"},
+        "Set how many threads encode and write images in the background, so that rendering "
+        "doesn't wait for storage. With 0 (the default), images are written by the rendering thread.",
+        [](Config& c, const std::string& val) { c.writer_options.threads = std::stoi(val); }
+    },
+    {
+        {"e", "queue"},
+        "Set how many rendered frames can wait for being written before rendering waits.",
+        [](Config& c, const std::string& val) { c.writer_options.queue_depth = std::stoi(val); }
+    },
+    {
+        {"x", "direct"},
+        "If present, images are written past the page cache of the system (O_DIRECT), which "
+        "helps with network storage.",
+        [](Config& c, const std::string& val) { c.writer_options.direct_io = true; },
+        false
+    },
+    {
+        {"g", "gif"},
+        "If present, the animation is saved as a looping GIF instead of a video, without the need "
+        "for temporary files.",
+        [](Config& c, const std::string& val) { c.gif_output = true; },
+        false
+    },
+    {
+        {"v", "stream"},
+        "If present, frames are streamed to FFmpeg as they are drawn instead of saved as images "
+        "into the directory for temporary files. Dimensions of the animation must be even.",
+        [](Config& c, const std::string& val) { c.stream_output = true; },
+        false
+    },
+    {
+        {"a", "archive"},
+        "Store frames in a single archive file with the given name instead of the directory for "
+        "temporary files. The archive is encoded into the output animation once finished.",
+        [](Config& c, const std::string& val) { c.frame_archive = val; }
+    },
+    {
+        {"m", "resume"},
+        "If present, frames saved by an interrupted render into the directory for temporary files "
+        "are checked and kept, and the render continues by the first missing frame.",
+        [](Config& c, const std::string& val) { c.resume = true; },
+        false
+    },
+    {
+        {"u", "serve"},
+        "Instead of rendering the animation, serve its frames on demand to scrubbing clients "
+        "connecting to the UNIX domain socket with the given path.",
+        [](Config& c, const std::string& val) { c.scrub_socket = val; }
     }
 };
 
@@ -205,6 +401,13 @@ Config Config::from_args(int argc, char* argv[])
         print_help(argv[0]);
         std::exit(0);
     }
+    if (conf.resume && !conf.frame_archive.empty())
+    {
+        // the archive would be cleared instead
+        std::cerr << "Renders into a frame archive cannot be resumed, -resume cannot be "
+                  << "combined with -archive." << std::endl;
+        std::exit(1);
+    }
     return conf;
 }
 
@@ -0,0 +1,66 @@
+#include "color.hh"
+#include "fingerprint.hh"
+#include "offset.hh"
+
+#include <algorithm> // std::equal
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <cstring> // std::memcpy
+
+namespace Sian {
+
+Fingerprint& Fingerprint::add(double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return add(bits);
+}
+
+Fingerprint& Fingerprint::add(std::uint64_t bits)
+{
+    // FNV-1a over the bytes of the value
+    for (int i = 0; i < 8; ++i)
+    {
+        hash ^= (bits >> (8 * i)) & 0xFF;
+        hash *= 1099511628211ull;
+    }
+
+    if (count < inline_capacity)
+        inline_values[count] = bits;
+    else
+        more_values.push_back(bits);
+    ++count;
+    return *this;
+}
+
+Fingerprint& Fingerprint::add(const Offset& value)
+{
+    return add(value.x).add(value.y);
+}
+
+Fingerprint& Fingerprint::add(const Color& value)
+{
+    return add(value.red()).add(value.green()).add(value.blue()).add(value.alpha());
+}
+
+std::uint64_t Fingerprint::value() const
+{
+    return hash;
+}
+
+bool Fingerprint::operator==(const Fingerprint& other) const
+{
+    // the hash rules out almost all differing fingerprints, the values decide the rest
+    if (hash != other.hash || count != other.count)
+        return false;
+    const std::size_t stored = count < inline_capacity ? count : inline_capacity;
+    return std::equal(inline_values, inline_values + stored, other.inline_values) &&
+           more_values == other.more_values;
+}
+
+bool Fingerprint::operator!=(const Fingerprint& other) const
+{
+    return !(*this == other);
+}
+
+} // namespace Sian
@@ -1,17 +1,27 @@
 #include "logger.hh"
 
 #include <iostream>
+#include <mutex>
 #include <string>
 
 namespace Sian {
 
+namespace {
+
+// keeps messages of animations rendered at once from interleaving
+std::mutex output_mutex;
+
+} // namespace Sian::{anonymous}
+
 void Logger::info(std::string msg)
 {
+    std::lock_guard<std::mutex> lock(output_mutex);
     std::cout << msg << std::endl;
 }
 
 void Logger::error(std::string msg)
 {
+    std::lock_guard<std::mutex> lock(output_mutex);
     std::cerr << msg << std::endl;
 }
 
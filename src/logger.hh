@@ -5,6 +5,7 @@
 
 namespace Sian {
 
+// Can be used by several threads at once, every message is written whole.
 class Logger
 {
 public:
@@ -16,6 +16,7 @@ using namespace Sian;
 int main(int argc, char* argv[])
 {
     Config conf = Config::from_args(argc, argv);
+    Object::set_sprite_memory_budget((std::size_t) conf.sprite_memory_budget * 1024 * 1024);
     Scene sc(conf);
     Animator anim(conf, sc);
 
@@ -144,6 +145,12 @@ int main(int argc, char* argv[])
         sc.add({car, left_wheel, right_wheel});
     }
 
+    if (!conf.scrub_socket.empty())
+    {
+        anim.serve(conf.scrub_socket, 5);
+        return 0;
+    }
+
     anim.wait(5);
     anim.finish();
 }
@@ -2,6 +2,7 @@
 
 #include <cairo.h>
 
+#include <algorithm> // std::min
 #include <cmath>
 #include <list>
 
@@ -22,14 +23,28 @@ Circle::~Circle()
 void Circle::draw(DrawContext cr)
 {
     push_context(cr);
+    append_path(cr);
+    cairo_stroke(cr);
+    pop_context(cr);
+}
 
-    cairo_translate(cr, radius, radius);
+void Circle::build_path(DrawContext cr) const
+{
+    const double lw = effective_line_width();
     cairo_new_sub_path(cr);
-    const double lw = std::min(radius, line_width);
-    cairo_arc(cr, 0.0, 0.0, radius - lw / 2, 0.0, 2 * M_PI * completion);
-    cairo_stroke(cr);
+    cairo_arc(cr, radius, radius, radius - lw / 2, 0.0, 2 * M_PI * completion);
+}
 
-    pop_context(cr);
+bool Circle::geometry(Fingerprint& fingerprint) const
+{
+    Shape::geometry(fingerprint);
+    fingerprint.add(radius).add(completion);
+    return true;
+}
+
+bool Circle::batchable() const
+{
+    return uniformly_scaled();
 }
 
 double Circle::natural_width() const
@@ -49,14 +64,14 @@ std::list<UpdatableValue*> Circle::animated_values()
     return values;
 }
 
-void Circle::push_context(DrawContext cr) const
+bool Circle::is_visible() const
+{
+    return Shape::is_visible() && completion > 0;
+}
+
+double Circle::effective_line_width() const
 {
-    Shape::push_context(cr);
-    if (line_width > radius)
-    {
-        // override the settings from Shape
-        cairo_set_line_width(cr, radius);
-    }
+    return std::min(radius.get(), line_width.get());
 }
 
 } // namespace Sian
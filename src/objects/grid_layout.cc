@@ -0,0 +1,64 @@
+#include "grid_layout.hh"
+#include "offset.hh"
+
+#include <algorithm> // std::max
+#include <cstddef> // std::size_t
+#include <initializer_list>
+#include <memory>
+#include <stdexcept> // std::invalid_argument
+#include <vector>
+
+namespace Sian {
+
+GridLayout::GridLayout(
+        const Offset& center,
+        int columns,
+        std::initializer_list<std::shared_ptr<Object>> children)
+    : Layout(center, children),
+      columns(columns > 0 ?
+                  columns :
+                  throw std::invalid_argument("A grid layout needs at least one column."))
+{
+    update_arrangement();
+}
+
+void GridLayout::arrange(std::vector<Slot>& slots, double& width, double& height) const
+{
+    const std::size_t cols = columns;
+    const std::size_t rows = (slots.size() + cols - 1) / cols;
+    column_widths.assign(cols, 0.0);
+    row_heights.assign(rows, 0.0);
+    for (std::size_t i = 0; i < slots.size(); ++i)
+    {
+        column_widths[i % cols] = std::max(column_widths[i % cols], slots[i].width);
+        row_heights[i / cols] = std::max(row_heights[i / cols], slots[i].height);
+    }
+
+    // replace the dimensions by starting coordinates of the columns and rows
+    width = 0;
+    for (double& column : column_widths)
+    {
+        const double column_width = column;
+        column = width;
+        width += column_width;
+    }
+    height = 0;
+    for (double& row : row_heights)
+    {
+        const double row_height = row;
+        row = height;
+        height += row_height;
+    }
+
+    for (std::size_t i = 0; i < slots.size(); ++i)
+    {
+        const std::size_t col = i % cols;
+        const std::size_t row = i / cols;
+        const double right = col + 1 < cols ? column_widths[col + 1] : width;
+        const double bottom = row + 1 < rows ? row_heights[row + 1] : height;
+        slots[i].center_x = (column_widths[col] + right) / 2;
+        slots[i].center_y = (row_heights[row] + bottom) / 2;
+    }
+}
+
+} // namespace Sian
@@ -0,0 +1,158 @@
+#include "layer.hh"
+#include "object.hh"
+#include "offset.hh"
+
+#include <cairo.h>
+
+#include <cmath> // std::ceil, std::hypot
+#include <cstddef> // std::size_t
+#include <list>
+#include <memory>
+#include <mutex>
+
+namespace Sian {
+
+namespace {
+
+// how many resolutions can a layer keep its rasters for
+const std::size_t max_rasters = 4;
+
+} // namespace Sian::{anonymous}
+
+Layer::Layer(std::shared_ptr<Object> child)
+    : Object(child->center.get()),
+      child(child)
+{
+    center.connect(child->center);
+}
+
+Layer::~Layer()
+{ }
+
+void Layer::draw(DrawContext cr)
+{
+    push_context(cr);
+
+    // the raster is kept in the resolution of the device
+    cairo_matrix_t m;
+    cairo_get_matrix(cr, &m);
+    const double device_scale_x = std::hypot(m.xx, m.yx);
+    const double device_scale_y = std::hypot(m.xy, m.yy);
+
+    Raster raster;
+    {
+        std::lock_guard<std::mutex> lock(raster_mutex);
+        std::size_t i = 0;
+        while (i < rasters.size() &&
+               (rasters[i].scale_x != device_scale_x || rasters[i].scale_y != device_scale_y))
+        {
+            ++i;
+        }
+        if (i == rasters.size())
+        {
+            // the oldest resolution is forgotten
+            if (rasters.size() >= max_rasters)
+                rasters.erase(rasters.begin());
+            rasters.push_back({nullptr, 0, device_scale_x, device_scale_y, 0});
+            i = rasters.size() - 1;
+        }
+
+        // moving the child only moves the raster, see push_context
+        const Revision revision = child->appearance_revision();
+        if (!rasters[i].surface || rasters[i].revision != revision)
+        {
+            rasterize(cr, rasters[i]);
+            rasters[i].revision = revision;
+        }
+        raster = rasters[i];
+    }
+
+    cairo_translate(cr, -raster.margin, -raster.margin);
+    cairo_scale(cr, 1 / device_scale_x, 1 / device_scale_y);
+    cairo_set_source_surface(cr, raster.surface.get(), 0.0, 0.0);
+    cairo_paint_with_alpha(cr, color.get().alpha() / 255);
+
+    pop_context(cr);
+}
+
+void Layer::rasterize(DrawContext cr, Raster& raster)
+{
+    const double margin = child->bleed();
+    const double width = natural_width() + 2 * margin;
+    const double height = natural_height() + 2 * margin;
+    raster.surface = std::shared_ptr<cairo_surface_t>(
+            cairo_image_surface_create(
+                CAIRO_FORMAT_ARGB32,
+                (int) std::ceil(width * raster.scale_x),
+                (int) std::ceil(height * raster.scale_y)),
+            cairo_surface_destroy);
+
+    cairo_t* layer_cr = cairo_create(raster.surface.get());
+    cairo_set_antialias(layer_cr, cairo_get_antialias(cr));
+    cairo_set_tolerance(layer_cr, cairo_get_tolerance(cr));
+    cairo_scale(layer_cr, raster.scale_x, raster.scale_y);
+    cairo_translate(layer_cr, margin, margin);
+    if (child->is_visible())
+    {
+        // the wrapper box of child starts at the origin of the layer
+        draw_placed(
+                layer_cr,
+                *child,
+                Offset(child->x_dimension() / 2, child->y_dimension() / 2));
+    }
+    cairo_destroy(layer_cr);
+
+    raster.margin = margin;
+}
+
+void Layer::layout()
+{
+    child->layout();
+    Object::layout();
+}
+
+std::list<UpdatableValue*> Layer::animated_values()
+{
+    auto values = Object::animated_values();
+    auto child_values = child->animated_values();
+    values.insert(values.end(), child_values.begin(), child_values.end());
+    return values;
+}
+
+bool Layer::is_visible() const
+{
+    return Object::is_visible() && child->is_visible();
+}
+
+double Layer::bleed() const
+{
+    return child->bleed();
+}
+
+void Layer::appearance(Fingerprint& fingerprint) const
+{
+    Object::appearance(fingerprint);
+    child->appearance(fingerprint);
+}
+
+std::size_t Layer::child_count() const
+{
+    return 1;
+}
+
+Object* Layer::nth_child(std::size_t) const
+{
+    return child.get();
+}
+
+double Layer::natural_width() const
+{
+    return child->x_dimension();
+}
+
+double Layer::natural_height() const
+{
+    return child->y_dimension();
+}
+
+} // namespace Sian
@@ -0,0 +1,131 @@
+#include "layout.hh"
+#include "object.hh"
+#include "offset.hh"
+
+#include <cstddef> // std::size_t
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace Sian {
+
+Layout::Layout(
+        const Offset& center,
+        std::initializer_list<std::shared_ptr<Object>> children)
+    : Object(center),
+      children(children.begin(), children.end())
+{ }
+
+Layout::~Layout()
+{ }
+
+void Layout::draw(DrawContext cr)
+{
+    if (slots.size() != children.size())
+        update_arrangement();
+
+    push_context(cr);
+    for (std::size_t i = 0; i < children.size(); ++i)
+    {
+        if (children[i]->is_visible())
+            draw_placed(cr, *children[i], Offset(slots[i].center_x, slots[i].center_y));
+    }
+    pop_context(cr);
+}
+
+void Layout::layout()
+{
+    // dimensions of nested containers have to be known first
+    for (auto& child : children)
+    {
+        child->layout();
+    }
+    if (!arrangement_valid())
+        update_arrangement();
+    Object::layout();
+}
+
+std::list<UpdatableValue*> Layout::animated_values()
+{
+    auto values = Object::animated_values();
+    for (auto& child : children)
+    {
+        auto child_values = child->animated_values();
+        values.insert(values.end(), child_values.begin(), child_values.end());
+    }
+    return values;
+}
+
+bool Layout::is_visible() const
+{
+    for (const auto& child : children)
+    {
+        if (child->is_visible())
+            return true;
+    }
+    return false;
+}
+
+void Layout::appearance(Fingerprint& fingerprint) const
+{
+    Object::appearance(fingerprint);
+    for (std::size_t i = 0; i < children.size(); ++i)
+    {
+        children[i]->appearance(fingerprint);
+        if (i < slots.size())
+            fingerprint.add(slots[i].center_x).add(slots[i].center_y);
+    }
+}
+
+std::size_t Layout::child_count() const
+{
+    return children.size();
+}
+
+Object* Layout::nth_child(std::size_t i) const
+{
+    return children[i].get();
+}
+
+double Layout::natural_width() const
+{
+    if (slots.size() != children.size())
+        update_arrangement();
+    return width;
+}
+
+double Layout::natural_height() const
+{
+    if (slots.size() != children.size())
+        update_arrangement();
+    return height;
+}
+
+void Layout::update_arrangement() const
+{
+    slots.resize(children.size());
+    for (std::size_t i = 0; i < children.size(); ++i)
+    {
+        slots[i].width = children[i]->x_dimension();
+        slots[i].height = children[i]->y_dimension();
+    }
+    arrange(slots, width, height);
+}
+
+bool Layout::arrangement_valid() const
+{
+    if (slots.size() != children.size())
+        return false;
+    for (std::size_t i = 0; i < children.size(); ++i)
+    {
+        if (slots[i].width != children[i]->x_dimension() ||
+            slots[i].height != children[i]->y_dimension())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace Sian
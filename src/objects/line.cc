@@ -29,7 +29,13 @@ Line::~Line()
 void Line::draw(DrawContext cr)
 {
     push_context(cr);
+    append_path(cr);
+    cairo_stroke(cr);
+    pop_context(cr);
+}
 
+void Line::build_path(DrawContext cr) const
+{
     const Offset start_norm =
         Offset(
             start.get().x - std::min(start.get().x, end.get().x),
@@ -42,9 +48,19 @@ void Line::draw(DrawContext cr)
         cr,
         start_norm.x + dx * completion.get(),
         start_norm.y + dy * completion.get());
-    cairo_stroke(cr);
+}
 
-    pop_context(cr);
+bool Line::geometry(Fingerprint& fingerprint) const
+{
+    Shape::geometry(fingerprint);
+    // only the relative position of the ends matters
+    fingerprint.add(end.get() - start.get()).add(completion);
+    return true;
+}
+
+bool Line::batchable() const
+{
+    return uniformly_scaled();
 }
 
 std::list<UpdatableValue*> Line::animated_values()
@@ -54,6 +70,17 @@ std::list<UpdatableValue*> Line::animated_values()
     return values;
 }
 
+bool Line::is_visible() const
+{
+    return Shape::is_visible() && completion > 0;
+}
+
+double Line::bleed() const
+{
+    // the stroke is centered on the line
+    return line_width / 2;
+}
+
 double Line::natural_width() const
 {
     return std::abs(start.get().x - end.get().x);
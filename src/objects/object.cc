@@ -5,15 +5,26 @@
 
 #include <cairo.h>
 
+#include <algorithm> // std::find, std::max, std::min, std::remove_if
+#include <atomic>
 #include <cmath>
+#include <cstddef> // std::size_t
 #include <iostream>
-#include <iterator> // std::end
+#include <iterator> // std::begin, std::end
 #include <list>
+#include <memory>
+#include <mutex>
 
 namespace Sian {
 
 namespace {
 
+std::atomic<std::size_t> sprite_memory_budget(256 * 1024 * 1024);
+std::atomic<std::size_t> sprite_memory_used(0);
+
+// how many resolutions can an object keep its sprites for
+const std::size_t max_sprites_per_object = 4;
+
 Offset bottom_right_halfdiagonal(const Object& o)
 {
     return Offset(o.object_width() / 2, o.object_height() / 2)
@@ -82,16 +93,16 @@ Object::Object(Offset center, Color color, double completion)
 { }
 
 Object::~Object()
-{ }
+{
+    release_sprites();
+}
 
 void Object::push_context(DrawContext cr) const
 {
     cairo_save(cr);
 
-    cairo_translate(cr, center.get().x, center.get().y);
-    cairo_scale(cr, scale_x, scale_y);
-    cairo_rotate(cr, rotation.get());
-    cairo_translate(cr, -natural_width() / 2, -natural_height() / 2);
+    const cairo_matrix_t matrix = local_matrix();
+    cairo_transform(cr, &matrix);
 
     Color c = color.get();
     cairo_set_source_rgba(
@@ -107,6 +118,253 @@ void Object::pop_context(DrawContext cr) const
     cairo_restore(cr);
 }
 
+void Object::layout()
+{
+    // children are laid out by now, so they have collected their values again if theirs
+    // have changed, and the natural dimensions are up to date
+    if (!children_current())
+        collect_values();
+    const Revision current = revision();
+    if (transform_cache.valid && transform_cache.revision == current)
+        return;
+    transform_cache.matrix = compute_local_matrix();
+    transform_cache.revision = current;
+    transform_cache.valid = true;
+}
+
+void Object::render(DrawContext cr)
+{
+    if (!sprite_caching_enabled)
+    {
+        draw(cr);
+        return;
+    }
+
+    cairo_matrix_t parent_matrix;
+    cairo_get_matrix(cr, &parent_matrix);
+    const cairo_matrix_t matrix = local_matrix();
+    cairo_matrix_t device_matrix;
+    cairo_matrix_multiply(&device_matrix, &matrix, &parent_matrix);
+
+    // a sprite can be reused if the transformation differs only in translation
+    Fingerprint scale_key;
+    scale_key.add(device_matrix.xx).add(device_matrix.yx).add(device_matrix.xy).add(device_matrix.yy);
+    Fingerprint key;
+    appearance(key);
+
+    std::shared_ptr<cairo_surface_t> sprite_surface;
+    double origin_x = 0, origin_y = 0;
+    {
+        std::lock_guard<std::mutex> lock(sprite_mutex);
+        Sprite* sprite = nullptr;
+        for (const auto& candidate : sprites)
+        {
+            if (candidate->scale_key == scale_key && candidate->key == key)
+                sprite = candidate.get();
+        }
+        if (!sprite)
+            sprite = rasterize_sprite(cr, device_matrix, scale_key, key);
+        if (sprite)
+        {
+            sprite->last_used = ++sprite_clock;
+            sprite_surface = sprite->surface;
+            origin_x = sprite->origin_x;
+            origin_y = sprite->origin_y;
+        }
+    }
+    if (!sprite_surface)
+    {
+        draw(cr);
+        return;
+    }
+
+    double center_x = natural_width() / 2;
+    double center_y = natural_height() / 2;
+    cairo_matrix_transform_point(&device_matrix, &center_x, &center_y);
+
+    cairo_save(cr);
+    cairo_identity_matrix(cr);
+    cairo_set_source_surface(
+            cr,
+            sprite_surface.get(),
+            center_x - origin_x,
+            center_y - origin_y);
+    // copying at whole pixels is exact, subpixel motion is interpolated
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BILINEAR);
+    cairo_paint(cr);
+    cairo_restore(cr);
+}
+
+void Object::set_sprite_caching(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(sprite_mutex);
+    sprite_caching_enabled = enabled;
+    if (!enabled)
+        release_sprites();
+}
+
+bool Object::sprite_caching() const
+{
+    return sprite_caching_enabled;
+}
+
+void Object::set_sprite_memory_budget(std::size_t bytes)
+{
+    sprite_memory_budget = bytes;
+}
+
+void Object::appearance(Fingerprint& fingerprint) const
+{
+    fingerprint
+        .add(color.get())
+        .add(scale_x)
+        .add(scale_y)
+        .add(rotation)
+        .add(completion)
+        .add(natural_width())
+        .add(natural_height());
+}
+
+Object::Sprite* Object::rasterize_sprite(
+        DrawContext cr,
+        const cairo_matrix_t& device_matrix,
+        const Fingerprint& scale_key,
+        const Fingerprint& key)
+{
+    std::size_t replaced = sprites.size();
+    for (std::size_t i = 0; i < sprites.size(); ++i)
+    {
+        if (sprites[i]->scale_key == scale_key)
+            replaced = i;
+    }
+    if (replaced == sprites.size() && sprites.size() >= max_sprites_per_object)
+    {
+        replaced = 0;
+        for (std::size_t i = 1; i < sprites.size(); ++i)
+        {
+            if (sprites[i]->last_used < sprites[replaced]->last_used)
+                replaced = i;
+        }
+    }
+    if (replaced < sprites.size())
+        release_sprite(replaced);
+
+    // bounding box of the object in device space, relative to its center
+    const double b = bleed();
+    const double w = natural_width();
+    const double h = natural_height();
+    double center_x = w / 2;
+    double center_y = h / 2;
+    cairo_matrix_transform_point(&device_matrix, &center_x, &center_y);
+    double min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    const double corners[4][2] = {{-b, -b}, {w + b, -b}, {w + b, h + b}, {-b, h + b}};
+    for (const auto& corner : corners)
+    {
+        double x = corner[0];
+        double y = corner[1];
+        cairo_matrix_transform_point(&device_matrix, &x, &y);
+        min_x = std::min(min_x, x - center_x);
+        min_y = std::min(min_y, y - center_y);
+        max_x = std::max(max_x, x - center_x);
+        max_y = std::max(max_y, y - center_y);
+    }
+
+    // one pixel of padding on each side for antialiasing
+    const int width = (int) std::ceil(max_x - min_x) + 2;
+    const int height = (int) std::ceil(max_y - min_y) + 2;
+    const std::size_t bytes =
+        (std::size_t) cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width) * height;
+    if (sprite_memory_used.fetch_add(bytes) + bytes > sprite_memory_budget)
+    {
+        sprite_memory_used -= bytes;
+        return nullptr;
+    }
+
+    auto new_sprite = std::make_unique<Sprite>();
+    new_sprite->surface = std::shared_ptr<cairo_surface_t>(
+            cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height),
+            cairo_surface_destroy);
+    new_sprite->scale_key = scale_key;
+    new_sprite->key = key;
+    new_sprite->origin_x = 1 - min_x;
+    new_sprite->origin_y = 1 - min_y;
+    new_sprite->bytes = bytes;
+
+    // draw as usual, only moved so that the center lands on the origin of the sprite
+    cairo_matrix_t sprite_matrix;
+    cairo_get_matrix(cr, &sprite_matrix);
+    sprite_matrix.x0 += new_sprite->origin_x - center_x;
+    sprite_matrix.y0 += new_sprite->origin_y - center_y;
+
+    cairo_t* sprite_cr = cairo_create(new_sprite->surface.get());
+    cairo_set_antialias(sprite_cr, cairo_get_antialias(cr));
+    cairo_set_tolerance(sprite_cr, cairo_get_tolerance(cr));
+    cairo_set_matrix(sprite_cr, &sprite_matrix);
+    draw(sprite_cr);
+    cairo_destroy(sprite_cr);
+
+    sprites.push_back(std::move(new_sprite));
+    return sprites.back().get();
+}
+
+void Object::release_sprite(std::size_t i)
+{
+    sprite_memory_used -= sprites[i]->bytes;
+    sprites.erase(sprites.begin() + i);
+}
+
+void Object::release_sprites()
+{
+    while (!sprites.empty())
+    {
+        release_sprite(sprites.size() - 1);
+    }
+}
+
+cairo_matrix_t Object::local_matrix() const
+{
+    // objects that haven't been laid out yet are drawn as they are
+    if (!transform_cache.valid)
+        return compute_local_matrix();
+    return transform_cache.matrix;
+}
+
+cairo_matrix_t Object::compute_local_matrix() const
+{
+    const Offset c = center.get();
+    const double w = natural_width();
+    const double h = natural_height();
+
+    cairo_matrix_t matrix;
+    cairo_matrix_init_translate(&matrix, c.x, c.y);
+    cairo_matrix_scale(&matrix, scale_x, scale_y);
+    cairo_matrix_rotate(&matrix, rotation);
+    cairo_matrix_translate(&matrix, -w / 2, -h / 2);
+    return matrix;
+}
+
+std::size_t Object::child_count() const
+{
+    return 0;
+}
+
+Object* Object::nth_child(std::size_t) const
+{
+    return nullptr;
+}
+
+void Object::draw_placed(DrawContext cr, Object& child, const Offset& placed_center)
+{
+    // the parent's transformation is extended by a translation, which is cheaper
+    // than rewriting the child's position (and cancelling its planned instructions)
+    const Offset shift = placed_center - child.center.get();
+    cairo_matrix_t parent_matrix;
+    cairo_get_matrix(cr, &parent_matrix);
+    cairo_translate(cr, shift.x, shift.y);
+    child.render(cr);
+    cairo_set_matrix(cr, &parent_matrix);
+}
+
 std::list<UpdatableValue*> Object::animated_values()
 {
     UpdatableValue* values[] = {
@@ -116,14 +374,162 @@ std::list<UpdatableValue*> Object::animated_values()
     return std::list<UpdatableValue*>(values, std::end(values));
 }
 
+const std::vector<UpdatableValue*>& Object::tracked_values()
+{
+    if (!tracked_values_current())
+        collect_values();
+    return values;
+}
+
+void Object::collect_values()
+{
+    const std::list<UpdatableValue*> animated = animated_values();
+    values.assign(animated.begin(), animated.end());
+    tracked_children.clear();
+    tracked_generations = 0;
+    for (std::size_t i = 0; i < child_count(); ++i)
+    {
+        Object* child = nth_child(i);
+        child->tracked_values();
+        tracked_children.push_back(child);
+        tracked_generations += child->values_generation;
+    }
+    values_collected = true;
+    ++values_generation;
+
+    // every change of a value deep in the subtree reaches the object directly, without
+    // walking the subtree; values that were dropped may still notify it, which is harmless
+    const UpdatableValue* position_values[] = {
+        &center, &offset, &top_left, &top_right, &bottom_right, &bottom_left
+    };
+    forget_dropped_observers();
+    std::vector<std::shared_ptr<ValueObserver>> alive;
+    for (const auto& observer : observers)
+    {
+        alive.push_back(observer.lock());
+    }
+    for (UpdatableValue* value : values)
+    {
+        value->observe(changes);
+        if (std::find(std::begin(position_values), std::end(position_values), value) ==
+            std::end(position_values))
+        {
+            value->observe(appearance_changes);
+        }
+        for (const auto& observer : alive)
+        {
+            value->observe(observer);
+        }
+    }
+
+    // other values are tracked now
+    changes->value_changed();
+    appearance_changes->value_changed();
+    for (const auto& observer : alive)
+    {
+        observer->value_changed();
+    }
+}
+
+void Object::observe(const std::shared_ptr<ValueObserver>& observer)
+{
+    forget_dropped_observers();
+    observers.push_back(observer);
+    for (UpdatableValue* value : tracked_values())
+    {
+        value->observe(observer);
+    }
+}
+
+void Object::forget_dropped_observers()
+{
+    observers.erase(
+            std::remove_if(
+                    observers.begin(),
+                    observers.end(),
+                    [] (const std::weak_ptr<ValueObserver>& observer) { return observer.expired(); }),
+            observers.end());
+}
+
+bool Object::tracked_values_current() const
+{
+    if (!values_collected || tracked_children.size() != child_count())
+        return false;
+
+    unsigned long generations = 0;
+    for (std::size_t i = 0; i < tracked_children.size(); ++i)
+    {
+        const Object* child = nth_child(i);
+        if (child != tracked_children[i] || !child->tracked_values_current())
+            return false;
+        generations += child->values_generation;
+    }
+    return generations == tracked_generations;
+}
+
+bool Object::children_current() const
+{
+    if (!values_collected || tracked_children.size() != child_count())
+        return false;
+
+    unsigned long generations = 0;
+    for (std::size_t i = 0; i < tracked_children.size(); ++i)
+    {
+        const Object* child = nth_child(i);
+        if (child != tracked_children[i])
+            return false;
+        generations += child->values_generation;
+    }
+    return generations == tracked_generations;
+}
+
+void Object::ChangeCounter::value_changed()
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
 void Object::step(double time_delta, StepID step_id)
 {
-    for (UpdatableValue* animated_value : animated_values())
+    for (UpdatableValue* animated_value : tracked_values())
     {
         animated_value->step(time_delta, step_id);
     }
 }
 
+Revision Object::revision()
+{
+    if (!values_collected)
+        collect_values();
+    return changes->count.load(std::memory_order_relaxed);
+}
+
+Revision Object::appearance_revision()
+{
+    if (!values_collected)
+        collect_values();
+    return appearance_changes->count.load(std::memory_order_relaxed);
+}
+
+bool Object::is_settled()
+{
+    for (UpdatableValue* animated_value : tracked_values())
+    {
+        if (!animated_value->is_settled())
+            return false;
+    }
+    return true;
+}
+
+bool Object::is_visible() const
+{
+    return color.get().alpha() > 0;
+}
+
+double Object::bleed() const
+{
+    return 0.0;
+}
+
 void Object::show_creation(const PaceValue& pace_value)
 {
     completion.set(0.0).animate_to(1.0, pace_value);
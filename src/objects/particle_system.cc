@@ -0,0 +1,276 @@
+#include "color.hh"
+#include "object.hh"
+#include "offset.hh"
+#include "particle_system.hh"
+
+#include <cairo.h>
+
+#include <algorithm> // std::any_of, std::max, std::min
+#include <cmath>
+#include <cstddef> // std::size_t
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace Sian {
+
+ParticleSystem::ParticleSystem(Offset center, double width, double height)
+    : Object(center),
+      width(width),
+      height(height),
+      acceleration(Offset::origin),
+      integrator(*this),
+      styles({Color::white})
+{ }
+
+ParticleSystem::~ParticleSystem()
+{ }
+
+auto ParticleSystem::add_style(const Color& color) -> Style
+{
+    styles.push_back(color);
+    return styles.size() - 1;
+}
+
+std::size_t ParticleSystem::add(
+        const Offset& position,
+        double radius,
+        const Offset& velocity,
+        Style style)
+{
+    x.push_back(position.x);
+    y.push_back(position.y);
+    velocity_x.push_back(velocity.x);
+    velocity_y.push_back(velocity.y);
+    this->radius.push_back(radius);
+    this->style.push_back(style);
+    invalidate();
+    return x.size() - 1;
+}
+
+void ParticleSystem::reserve(std::size_t count)
+{
+    x.reserve(count);
+    y.reserve(count);
+    velocity_x.reserve(count);
+    velocity_y.reserve(count);
+    radius.reserve(count);
+    style.reserve(count);
+}
+
+std::size_t ParticleSystem::size() const
+{
+    return x.size();
+}
+
+void ParticleSystem::invalidate()
+{
+    integrator.invalidate();
+}
+
+void ParticleSystem::draw(DrawContext cr)
+{
+    push_context(cr);
+
+    const Color system_color = color.get();
+    const double system_alpha = system_color.alpha() / 255;
+    const std::size_t count =
+        (std::size_t) (size() * std::max(0.0, std::min(1.0, completion.get())));
+
+    // particles are bucketed by style (counting sort), so that the buffers are walked
+    // only once; bucket s takes order[bucket_start[s]] up to order[bucket_start[s + 1]]
+    std::vector<std::size_t> bucket_start(styles.size() + 1, 0);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (style[i] < styles.size())
+            ++bucket_start[style[i] + 1];
+    }
+    for (Style s = 0; s < styles.size(); ++s)
+    {
+        bucket_start[s + 1] += bucket_start[s];
+    }
+    std::vector<std::size_t> order(bucket_start.back());
+    std::vector<std::size_t> next(bucket_start.begin(), bucket_start.end() - 1);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (style[i] < styles.size())
+            order[next[style[i]]++] = i;
+    }
+
+    for (Style s = 0; s < styles.size(); ++s)
+    {
+        if (bucket_start[s] == bucket_start[s + 1])
+            continue;
+
+        const Color c = s == default_style ? system_color : styles[s];
+        cairo_set_source_rgba(
+                cr,
+                c.red() / 255,
+                c.green() / 255,
+                c.blue() / 255,
+                s == default_style ? system_alpha : c.alpha() / 255 * system_alpha);
+
+        // all particles of the same style form a single path
+        for (std::size_t k = bucket_start[s]; k < bucket_start[s + 1]; ++k)
+        {
+            const std::size_t i = order[k];
+            cairo_new_sub_path(cr);
+            cairo_arc(cr, x[i], y[i], radius[i], 0.0, 2 * M_PI);
+        }
+        cairo_fill(cr);
+    }
+
+    pop_context(cr);
+}
+
+std::list<UpdatableValue*> ParticleSystem::animated_values()
+{
+    auto values = Object::animated_values();
+    values.insert(values.end(), {&width, &height, &acceleration, &integrator});
+    return values;
+}
+
+bool ParticleSystem::is_visible() const
+{
+    return Object::is_visible() && completion > 0 && size() > 0;
+}
+
+void ParticleSystem::appearance(Fingerprint& fingerprint) const
+{
+    Object::appearance(fingerprint);
+    fingerprint.add(integrator.revision());
+    for (const Color& style_color : styles)
+    {
+        fingerprint.add(style_color);
+    }
+}
+
+double ParticleSystem::natural_width() const
+{
+    return width;
+}
+
+double ParticleSystem::natural_height() const
+{
+    return height;
+}
+
+ParticleSystem::Integrator::Integrator(ParticleSystem& system)
+    : system(system)
+{ }
+
+void ParticleSystem::Integrator::step(double time_delta, StepID step_id)
+{
+    if (step_id < next_step_id)
+        return;
+    next_step_id = step_id + 1;
+
+    const std::size_t n = system.size();
+    const Offset a = system.acceleration.get();
+    if (a.x != 0 || a.y != 0)
+    {
+        const double dvx = a.x * time_delta;
+        const double dvy = a.y * time_delta;
+        double* vx = system.velocity_x.data();
+        double* vy = system.velocity_y.data();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            vx[i] += dvx;
+        }
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            vy[i] += dvy;
+        }
+    }
+    else
+    {
+        const auto moving = [] (double v) { return v != 0; };
+        if (!std::any_of(system.velocity_x.begin(), system.velocity_x.end(), moving) &&
+            !std::any_of(system.velocity_y.begin(), system.velocity_y.end(), moving))
+        {
+            this->moving = false;
+            return;
+        }
+    }
+
+    // separate loops over contiguous buffers are vectorized by the compiler
+    const double* vx = system.velocity_x.data();
+    const double* vy = system.velocity_y.data();
+    double* px = system.x.data();
+    double* py = system.y.data();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        px[i] += vx[i] * time_delta;
+    }
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        py[i] += vy[i] * time_delta;
+    }
+    ++current_revision;
+    observers.notify();
+    this->moving = true;
+}
+
+Revision ParticleSystem::Integrator::revision() const
+{
+    return current_revision;
+}
+
+void ParticleSystem::Integrator::observe(const std::shared_ptr<ValueObserver>& observer)
+{
+    observers.add(observer);
+}
+
+bool ParticleSystem::Integrator::is_settled() const
+{
+    return !moving;
+}
+
+bool ParticleSystem::Integrator::may_finish(double time_delta) const
+{
+    return false;
+}
+
+struct ParticleSystem::Integrator::State : public ValueState
+{
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> velocity_x;
+    std::vector<double> velocity_y;
+    std::vector<double> radius;
+    std::vector<Style> style;
+};
+
+std::unique_ptr<ValueState> ParticleSystem::Integrator::save_state() const
+{
+    auto state = std::make_unique<State>();
+    state->x = system.x;
+    state->y = system.y;
+    state->velocity_x = system.velocity_x;
+    state->velocity_y = system.velocity_y;
+    state->radius = system.radius;
+    state->style = system.style;
+    return state;
+}
+
+void ParticleSystem::Integrator::restore_state(const ValueState& state)
+{
+    const State& saved = dynamic_cast<const State&>(state);
+    system.x = saved.x;
+    system.y = saved.y;
+    system.velocity_x = saved.velocity_x;
+    system.velocity_y = saved.velocity_y;
+    system.radius = saved.radius;
+    system.style = saved.style;
+    invalidate();
+}
+
+void ParticleSystem::Integrator::invalidate()
+{
+    ++current_revision;
+    observers.notify();
+    // velocities might have been changed as well
+    moving = true;
+}
+
+} // namespace Sian
@@ -23,13 +23,27 @@ double max_line_width(double width, double height)
 void Rectangle::draw(DrawContext cr)
 {
     push_context(cr);
+    append_path(cr);
+    cairo_stroke(cr);
+    pop_context(cr);
+}
 
-    const double m = max_line_width(width, height);
-    const double lw = std::min(m, line_width.get());
+void Rectangle::build_path(DrawContext cr) const
+{
+    const double lw = effective_line_width();
     cairo_rectangle(cr, lw / 2, lw / 2, width - lw, height - lw);
-    cairo_stroke(cr);
+}
 
-    pop_context(cr);
+bool Rectangle::geometry(Fingerprint& fingerprint) const
+{
+    Shape::geometry(fingerprint);
+    fingerprint.add(width).add(height);
+    return true;
+}
+
+bool Rectangle::batchable() const
+{
+    return uniformly_scaled();
 }
 
 std::list<UpdatableValue*> Rectangle::animated_values()
@@ -49,17 +63,15 @@ double Rectangle::natural_height() const
     return height;
 }
 
-void Rectangle::push_context(DrawContext cr) const
+double Rectangle::effective_line_width() const
+{
+    return std::min(max_line_width(width, height), line_width.get());
+}
+
+cairo_line_join_t Rectangle::line_join() const
 {
-    Shape::push_context(cr);
     // alternatives: CAIRO_LINE_JOIN_ROUND, CAIRO_LINE_JOIN_BEVEL
-    cairo_set_line_join(cr, CAIRO_LINE_JOIN_MITER);
-    const double m = max_line_width(width, height);
-    if (line_width > m)
-    {
-        // override the settings from Shape
-        cairo_set_line_width(cr, m);
-    }
+    return CAIRO_LINE_JOIN_MITER;
 }
 
 } // namespace Sian
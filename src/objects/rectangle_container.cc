@@ -4,6 +4,7 @@
 
 #include <cairo.h>
 
+#include <cstddef> // std::size_t
 #include <memory>
 
 namespace Sian {
@@ -19,17 +20,31 @@ RectangleContainer::~RectangleContainer()
 
 void RectangleContainer::draw(DrawContext cr)
 {
-    // update rectangle's dimensions based on those of child
-    width = natural_width();
-    height = natural_height();
     Rectangle::draw(cr);
 
     push_context(cr);
-    child->offset = Offset(padding, padding);
-    child->draw(cr);
+    const Offset child_center = Offset(
+            padding + child->x_dimension() / 2,
+            padding + child->y_dimension() / 2);
+    draw_placed(cr, *child, child_center);
     pop_context(cr);
 }
 
+void RectangleContainer::layout()
+{
+    child->layout();
+
+    // update rectangle's dimensions based on those of child
+    // (only when they differ, as setting a value cancels its planned instructions)
+    const double w = natural_width();
+    const double h = natural_height();
+    if (width.get() != w)
+        width = w;
+    if (height.get() != h)
+        height = h;
+    Rectangle::layout();
+}
+
 std::list<UpdatableValue*> RectangleContainer::animated_values()
 {
     auto values = Rectangle::animated_values();
@@ -38,6 +53,23 @@ std::list<UpdatableValue*> RectangleContainer::animated_values()
     return values;
 }
 
+bool RectangleContainer::is_visible() const
+{
+    return Rectangle::is_visible() || child->is_visible();
+}
+
+bool RectangleContainer::batchable() const
+{
+    // the child is drawn as well
+    return false;
+}
+
+void RectangleContainer::appearance(Fingerprint& fingerprint) const
+{
+    Rectangle::appearance(fingerprint);
+    child->appearance(fingerprint);
+}
+
 double RectangleContainer::natural_width() const
 {
     return child->object_width() + 2 * padding;
@@ -48,4 +80,14 @@ double RectangleContainer::natural_height() const
     return child->object_height() + 2 * padding;
 }
 
+std::size_t RectangleContainer::child_count() const
+{
+    return 1;
+}
+
+Object* RectangleContainer::nth_child(std::size_t) const
+{
+    return child.get();
+}
+
 } // namespace Sian
@@ -1,11 +1,60 @@
+#include "color.hh"
 #include "object.hh"
 #include "offset.hh"
 #include "shape.hh"
 
+#include <cairo.h>
+
 #include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace Sian {
 
+namespace {
+
+// Context for building outlines of shapes, so that they can be copied without
+// anything else that might be in the current path of the drawing context.
+class PathContext
+{
+public:
+    PathContext()
+        : surface(cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1)),
+          cr(cairo_create(surface))
+    { }
+
+    ~PathContext()
+    {
+        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
+    }
+
+    cairo_t* get()
+    {
+        return cr;
+    }
+
+private:
+    cairo_surface_t* surface;
+    cairo_t* cr;
+};
+
+} // namespace Sian::{anonymous}
+
+bool StrokeStyle::operator==(const StrokeStyle& other) const
+{
+    return red == other.red && green == other.green && blue == other.blue &&
+           alpha == other.alpha &&
+           line_width == other.line_width &&
+           line_join == other.line_join;
+}
+
+bool StrokeStyle::operator!=(const StrokeStyle& other) const
+{
+    return !(*this == other);
+}
+
 Shape::Shape(Offset center, double line_width)
     : Object(center), line_width(line_width)
 { }
@@ -20,10 +69,122 @@ std::list<UpdatableValue*> Shape::animated_values()
     return values;
 }
 
+void Shape::appearance(Fingerprint& fingerprint) const
+{
+    Object::appearance(fingerprint);
+    geometry(fingerprint);
+}
+
+void Shape::append_path(DrawContext cr) const
+{
+    Fingerprint fingerprint;
+    if (!geometry(fingerprint))
+    {
+        build_path(cr);
+        return;
+    }
+
+    std::shared_ptr<cairo_path_t> path;
+    {
+        std::lock_guard<std::mutex> lock(path_mutex);
+        if (!cached_path || fingerprint != cached_geometry)
+        {
+            thread_local PathContext path_context;
+            cairo_t* path_cr = path_context.get();
+            cairo_new_path(path_cr);
+            build_path(path_cr);
+            cached_path = std::shared_ptr<cairo_path_t>(
+                    cairo_copy_path(path_cr),
+                    cairo_path_destroy);
+            cached_geometry = fingerprint;
+            if (cached_path->status != CAIRO_STATUS_SUCCESS)
+                cached_path.reset();
+        }
+        path = cached_path;
+    }
+    if (!path)
+    {
+        build_path(cr);
+        return;
+    }
+    cairo_append_path(cr, path.get());
+}
+
+void Shape::build_path(DrawContext cr) const
+{ }
+
+bool Shape::geometry(Fingerprint& fingerprint) const
+{
+    fingerprint.add(effective_line_width());
+    return false;
+}
+
+bool Shape::batchable() const
+{
+    return false;
+}
+
+StrokeStyle Shape::stroke_style() const
+{
+    const Color c = color.get();
+    return {
+        c.red() / 255,
+        c.green() / 255,
+        c.blue() / 255,
+        c.alpha() / 255,
+        // shapes in a batch are stroked without their own scaling
+        effective_line_width() * scale_x,
+        line_join()
+    };
+}
+
+void Shape::draw_batch(DrawContext cr, const std::vector<Shape*>& shapes)
+{
+    if (shapes.empty())
+        return;
+
+    cairo_save(cr);
+
+    const StrokeStyle style = shapes.front()->stroke_style();
+    cairo_set_source_rgba(cr, style.red, style.green, style.blue, style.alpha);
+    cairo_set_line_width(cr, style.line_width);
+    cairo_set_line_join(cr, style.line_join);
+
+    // the path is kept in device coordinates, so it survives the changes of the matrix
+    cairo_matrix_t base_matrix;
+    cairo_get_matrix(cr, &base_matrix);
+    for (const Shape* shape : shapes)
+    {
+        const cairo_matrix_t matrix = shape->local_matrix();
+        cairo_transform(cr, &matrix);
+        shape->append_path(cr);
+        cairo_set_matrix(cr, &base_matrix);
+    }
+    cairo_stroke(cr);
+
+    cairo_restore(cr);
+}
+
 void Shape::push_context(DrawContext cr) const
 {
     Object::push_context(cr);
-    cairo_set_line_width(cr, line_width);
+    cairo_set_line_width(cr, effective_line_width());
+    cairo_set_line_join(cr, line_join());
+}
+
+double Shape::effective_line_width() const
+{
+    return line_width;
+}
+
+cairo_line_join_t Shape::line_join() const
+{
+    return CAIRO_LINE_JOIN_MITER;
+}
+
+bool Shape::uniformly_scaled() const
+{
+    return scale_x == scale_y && scale_x > 0;
 }
 
 } // namespace Sian
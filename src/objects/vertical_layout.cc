@@ -0,0 +1,32 @@
+#include "offset.hh"
+#include "vertical_layout.hh"
+
+#include <algorithm> // std::max
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace Sian {
+
+VerticalLayout::VerticalLayout(
+        const Offset& center,
+        std::initializer_list<std::shared_ptr<Object>> children)
+    : Layout(center, children)
+{
+    update_arrangement();
+}
+
+void VerticalLayout::arrange(std::vector<Slot>& slots, double& width, double& height) const
+{
+    width = 0;
+    height = 0;
+    for (Slot& slot : slots)
+    {
+        slot.center_x = slot.width / 2;
+        slot.center_y = height + slot.height / 2;
+        width = std::max(width, slot.width);
+        height += slot.height;
+    }
+}
+
+} // namespace Sian
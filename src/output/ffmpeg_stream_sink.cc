@@ -0,0 +1,156 @@
+#include "ffmpeg_stream_sink.hh"
+#include "logger.hh"
+#include "scene.hh"
+#include "utils.hh"
+#include "yuv.hh"
+
+#include <cairo.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio> // popen, pclose, std::fwrite
+#include <ctime> // timespec
+#include <pthread.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+
+namespace Sian {
+
+namespace {
+
+// Blocks SIGPIPE in the calling thread while writing to FFmpeg, so that FFmpeg exiting early
+// makes the write fail instead of killing the process. A SIGPIPE raised meanwhile is discarded.
+class SigpipeGuard
+{
+public:
+    SigpipeGuard()
+    {
+        sigemptyset(&sigpipe);
+        sigaddset(&sigpipe, SIGPIPE);
+
+        sigset_t pending;
+        sigpending(&pending);
+        was_pending = sigismember(&pending, SIGPIPE) == 1;
+        pthread_sigmask(SIG_BLOCK, &sigpipe, &previous);
+    }
+
+    ~SigpipeGuard()
+    {
+        if (!was_pending)
+        {
+            const timespec no_wait = {0, 0};
+            while (sigtimedwait(&sigpipe, nullptr, &no_wait) < 0 && errno == EINTR)
+            { }
+        }
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    }
+
+private:
+    sigset_t sigpipe;
+    sigset_t previous;
+    bool was_pending;
+};
+
+} // namespace Sian::{anonymous}
+
+FfmpegStreamSink::FfmpegStreamSink(const Config& config)
+    : FfmpegStreamSink(config.output_file, config.fps)
+{ }
+
+FfmpegStreamSink::FfmpegStreamSink(
+        const std::string& output_file,
+        double fps,
+        ChromaLayout layout)
+    : output_file(output_file),
+      fps(fps),
+      layout(layout)
+{ }
+
+FfmpegStreamSink::~FfmpegStreamSink()
+{
+    if (pipe)
+    {
+        SigpipeGuard guard;
+        pclose(pipe);
+    }
+}
+
+void FfmpegStreamSink::open(int frame_width, int frame_height)
+{
+    // chroma of YUV 4:2:0 is subsampled by 2x2 blocks, which libx264 requires whole
+    if (frame_width % 2 != 0 || frame_height % 2 != 0)
+    {
+        throw std::invalid_argument(Utils::str_format(
+                "Frames streamed to FFmpeg must have even dimensions, not %dx%d.",
+                frame_width,
+                frame_height));
+    }
+    width = frame_width;
+    height = frame_height;
+    buffer.resize(yuv420_size(width, height));
+
+    std::ostringstream ss;
+    ss << "ffmpeg -y -f rawvideo -pix_fmt "
+       << (layout == ChromaLayout::I420 ? "yuv420p" : "nv12")
+       << " -s " << width << "x" << height
+       << " -r " << std::to_string(fps)
+       << " -i - -vcodec libx264 -crf 25 -pix_fmt yuv420p "
+       << Utils::with_extension(output_file, ".mp4");
+    Logger::info(ss.str());
+
+    pipe = popen(ss.str().c_str(), "w");
+    if (!pipe)
+        throw std::runtime_error("Cannot start FFmpeg.");
+}
+
+void FfmpegStreamSink::write(const Scene::Snapshot& frame)
+{
+    const Scene::Snapshot::Pixels pixels = frame.pixels();
+    if (pixels.format != CAIRO_FORMAT_ARGB32 && pixels.format != CAIRO_FORMAT_RGB24)
+        throw std::invalid_argument("Only frames with 32 bits per pixel can be streamed.");
+
+    if (!pipe)
+    {
+        open(pixels.width, pixels.height);
+    }
+    else if (pixels.width != width || pixels.height != height)
+    {
+        throw std::logic_error(Utils::str_format(
+                "All frames streamed to %s must have the same dimensions.",
+                output_file.c_str()));
+    }
+
+    argb_to_yuv420(
+            pixels.data,
+            pixels.stride,
+            width,
+            height,
+            layout,
+            buffer.data());
+    SigpipeGuard guard;
+    if (std::fwrite(buffer.data(), 1, buffer.size(), pipe) != buffer.size())
+        throw std::runtime_error("Writing a frame to FFmpeg failed, FFmpeg may have exited.");
+}
+
+void FfmpegStreamSink::finish()
+{
+    if (!pipe)
+        return;
+
+    int status;
+    {
+        SigpipeGuard guard;
+        status = pclose(pipe);
+    }
+    pipe = nullptr;
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "FFmpeg failed to encode %s.",
+                Utils::with_extension(output_file, ".mp4").c_str()));
+    }
+}
+
+} // namespace Sian
@@ -0,0 +1,196 @@
+#include "file_writer.hh"
+#include "utils.hh"
+
+#include <cerrno>
+#include <cstddef> // std::size_t
+#include <cstdlib> // std::free
+#include <cstring> // std::memcpy, std::memset, std::strerror
+#include <exception>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace Sian {
+
+namespace {
+
+// O_DIRECT needs buffers, offsets and sizes aligned to the logical block size of the device,
+// which this is a multiple of on all common devices
+const std::size_t direct_alignment = 4096;
+
+bool write_all(int fd, const unsigned char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+#ifdef O_DIRECT
+
+// Returns false if the file system doesn't support direct writes, so that the file can be
+// written the usual way instead.
+bool write_direct(const std::string& filename, const unsigned char* data, std::size_t size)
+{
+    const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (fd < 0)
+        return false;
+
+    // the data is copied into an aligned buffer padded to whole blocks, and the padding is
+    // cut off afterwards
+    const std::size_t padded_size = (size + direct_alignment - 1) / direct_alignment *
+                                    direct_alignment;
+    void* memory = nullptr;
+    if (padded_size > 0 && posix_memalign(&memory, direct_alignment, padded_size) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    std::unique_ptr<unsigned char, decltype(&std::free)> buffer(
+            (unsigned char*) memory,
+            std::free);
+    std::memcpy(buffer.get(), data, size);
+    std::memset(buffer.get() + size, 0, padded_size - size);
+
+    const bool written = write_all(fd, buffer.get(), padded_size) &&
+                         ftruncate(fd, size) == 0;
+    const int write_error = errno;
+    const bool closed = ::close(fd) == 0;
+    // alignment the device doesn't support
+    if (!written && write_error == EINVAL)
+        return false;
+    if (!written || !closed)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Cannot write %s: %s",
+                filename.c_str(),
+                std::strerror(written ? errno : write_error)));
+    }
+    return true;
+}
+
+#endif
+
+} // namespace Sian::{anonymous}
+
+void write_file(
+        const std::string& filename,
+        const unsigned char* data,
+        std::size_t size,
+        bool direct)
+{
+#ifdef O_DIRECT
+    if (direct && write_direct(filename, data, size))
+        return;
+#endif
+
+    const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    const bool written = fd >= 0 && write_all(fd, data, size);
+    const bool closed = fd >= 0 && ::close(fd) == 0;
+    if (!written || !closed)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Cannot write %s: %s", filename.c_str(), std::strerror(errno)));
+    }
+}
+
+AsyncFileWriter::AsyncFileWriter(int thread_count, int queue_depth)
+    : queue_depth(queue_depth)
+{
+    if (thread_count < 1 || queue_depth < 1)
+        throw std::invalid_argument("The file writer needs at least one thread and queue slot.");
+
+    for (int i = 0; i < thread_count; ++i)
+    {
+        threads.emplace_back(&AsyncFileWriter::run, this);
+    }
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_queued.notify_all();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void AsyncFileWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        job_queued.wait(lock, [this] { return stopping || !queue.empty(); });
+        // the remaining jobs are finished before stopping
+        if (queue.empty())
+            return;
+
+        std::function<void()> job = std::move(queue.front());
+        queue.pop_front();
+        ++running_jobs;
+        job_done.notify_all();
+
+        lock.unlock();
+        std::exception_ptr job_error;
+        try
+        {
+            job();
+        }
+        catch (...)
+        {
+            job_error = std::current_exception();
+        }
+        lock.lock();
+
+        if (job_error && !error)
+            error = job_error;
+        --running_jobs;
+        job_done.notify_all();
+    }
+}
+
+void AsyncFileWriter::rethrow_error()
+{
+    if (error)
+    {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+void AsyncFileWriter::submit(std::function<void()> job)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    job_done.wait(lock, [this] { return queue.size() < queue_depth || error; });
+    rethrow_error();
+
+    queue.push_back(std::move(job));
+    lock.unlock();
+    job_queued.notify_one();
+}
+
+void AsyncFileWriter::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    job_done.wait(lock, [this] { return queue.empty() && running_jobs == 0; });
+    rethrow_error();
+}
+
+} // namespace Sian
@@ -0,0 +1,65 @@
+#ifndef FILE_WRITER_HH
+#define FILE_WRITER_HH
+
+#include <condition_variable>
+#include <cstddef> // std::size_t
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Sian {
+
+// Writes data into a new file, or replaces the content of an existing one. With direct, the file
+// is written past the page cache (O_DIRECT) if the file system supports it. Throws
+// std::runtime_error if the file cannot be written.
+void write_file(
+        const std::string& filename,
+        const unsigned char* data,
+        std::size_t size,
+        bool direct = false);
+
+// Runs jobs (typically encoding and writing a frame) on background threads, so that the thread
+// submitting them doesn't wait for slow storage. Jobs may finish in any order.
+class AsyncFileWriter
+{
+public:
+    // At most queue_depth jobs wait for a thread, submit() blocks beyond that.
+    AsyncFileWriter(int threads, int queue_depth);
+
+    AsyncFileWriter(const AsyncFileWriter& other) = delete;
+
+    // Waits for all submitted jobs, ignoring their errors.
+    ~AsyncFileWriter();
+
+    // Throws the error of a previous job, if any has failed.
+    void submit(std::function<void()> job);
+
+    // Waits until all submitted jobs have finished and throws the error of the first job
+    // that has failed, if any.
+    void wait();
+
+private:
+    void run();
+
+    void rethrow_error();
+
+    std::size_t queue_depth;
+    std::mutex mutex;
+    // notified when a job is queued or the writer stops
+    std::condition_variable job_queued;
+    // notified when a job is taken from the queue or finished
+    std::condition_variable job_done;
+    std::deque<std::function<void()>> queue;
+    int running_jobs = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::vector<std::thread> threads;
+};
+
+} // namespace Sian
+
+#endif
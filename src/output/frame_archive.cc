@@ -0,0 +1,111 @@
+#include "frame_archive.hh"
+
+#include <algorithm> // std::fill, std::min
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstring> // std::memcpy
+
+namespace Sian {
+namespace FrameArchive {
+
+namespace {
+
+const std::uint32_t run_flag = 0x80000000u;
+
+} // namespace Sian::FrameArchive::{anonymous}
+
+std::size_t encode_runs(
+        const unsigned char* pixels,
+        int stride,
+        int width,
+        int height,
+        unsigned char* out,
+        std::size_t capacity)
+{
+    std::uint32_t* words = (std::uint32_t*) out;
+    const std::size_t max_words = capacity / 4;
+    std::size_t size = 0;
+
+    // runs don't continue across rows
+    for (int y = 0; y < height; ++y)
+    {
+        const std::uint32_t* row = (const std::uint32_t*) (pixels + (std::size_t) y * stride);
+        int x = 0;
+        while (x < width)
+        {
+            int run = 1;
+            while (x + run < width && row[x + run] == row[x])
+            {
+                ++run;
+            }
+            // runs of two pixels are cheaper as literals
+            if (run > 2)
+            {
+                if (size + 2 > max_words)
+                    return 0;
+                words[size++] = run_flag | (std::uint32_t) run;
+                words[size++] = row[x];
+                x += run;
+                continue;
+            }
+
+            // literals continue until a run of at least three pixels starts
+            int literals = 0;
+            while (x + literals < width)
+            {
+                const int i = x + literals;
+                if (i + 2 < width && row[i] == row[i + 1] && row[i] == row[i + 2])
+                    break;
+                ++literals;
+            }
+            if (size + 1 + literals > max_words)
+                return 0;
+            words[size++] = (std::uint32_t) literals;
+            std::memcpy(words + size, row + x, (std::size_t) literals * 4);
+            size += literals;
+            x += literals;
+        }
+    }
+    return size * 4;
+}
+
+void decode_runs(
+        const unsigned char* data,
+        std::size_t size,
+        int stride,
+        int width,
+        int height,
+        unsigned char* pixels)
+{
+    const std::uint32_t* words = (const std::uint32_t*) data;
+    const std::size_t word_count = size / 4;
+    std::size_t position = 0;
+
+    for (int y = 0; y < height && position < word_count; ++y)
+    {
+        std::uint32_t* row = (std::uint32_t*) (pixels + (std::size_t) y * stride);
+        int x = 0;
+        while (x < width && position < word_count)
+        {
+            const std::uint32_t word = words[position++];
+            const int length = std::min((int) (word & ~run_flag), width - x);
+            if (word & run_flag)
+            {
+                if (position == word_count)
+                    return;
+                std::fill(row + x, row + x + length, words[position++]);
+            }
+            else
+            {
+                if (position + length > word_count)
+                    return;
+                std::memcpy(row + x, words + position, (std::size_t) length * 4);
+                position += length;
+            }
+            x += length;
+        }
+    }
+}
+
+} // namespace Sian::FrameArchive
+} // namespace Sian
@@ -0,0 +1,121 @@
+#ifndef FRAME_ARCHIVE_HH
+#define FRAME_ARCHIVE_HH
+
+#include <atomic>
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <vector>
+
+namespace Sian {
+namespace FrameArchive {
+
+// Layout of the archive file, common to FrameArchiveSink and FrameArchiveReader. The file starts
+// with Header, followed by slots of slot_size bytes, one for every frame. Each slot starts with
+// SlotHeader, followed by the (possibly compressed) pixels. Slots are never written partially
+// by more writers, so any number of threads or processes can fill different slots at once.
+// Parts of the file that haven't been written yet take no space on file systems supporting
+// sparse files.
+
+const std::uint32_t magic = 0x5349414E;
+const std::uint32_t version = 1;
+
+// slots start at page boundaries
+const std::size_t slot_alignment = 4096;
+
+enum SlotState : std::uint32_t
+{
+    EMPTY = 0,
+    WRITING = 1,
+    READY = 2
+};
+
+enum Encoding : std::uint32_t
+{
+    RAW = 0,
+    // runs of equal pixels, see encode_runs()
+    RUNS = 1
+};
+
+struct Header
+{
+    // written last, once the rest of the header is filled in
+    std::atomic<std::uint32_t> magic;
+    std::uint32_t version;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t stride;
+    // value of cairo_format_t
+    std::int32_t format;
+    double fps;
+    std::uint64_t slot_size;
+    std::uint64_t slots_offset;
+    // number of slots the file has room for
+    std::atomic<std::uint64_t> capacity;
+    // one more than the index of the last frame written by any writer that has finished
+    std::atomic<std::uint64_t> frame_count;
+};
+
+struct SlotHeader
+{
+    std::atomic<std::uint32_t> state;
+    std::uint32_t encoding;
+    // number of bytes of data following the header
+    std::uint64_t size;
+};
+
+static_assert(
+        std::atomic<std::uint64_t>::is_always_lock_free &&
+        std::atomic<std::uint32_t>::is_always_lock_free,
+        "atomics in shared memory have to be lock-free");
+
+inline std::size_t aligned(std::size_t size, std::size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// data of slots starts at a cache line
+const std::size_t slot_data_offset = 64;
+
+inline std::size_t file_size(const Header& header, std::uint64_t capacity)
+{
+    return header.slots_offset + header.slot_size * capacity;
+}
+
+inline SlotHeader* slot(void* memory, std::uint64_t frame)
+{
+    const Header* header = (const Header*) memory;
+    return (SlotHeader*) ((unsigned char*) memory +
+                          header->slots_offset +
+                          frame * header->slot_size);
+}
+
+inline unsigned char* slot_data(void* memory, std::uint64_t frame)
+{
+    return (unsigned char*) slot(memory, frame) + slot_data_offset;
+}
+
+// Compresses rows of 32-bit pixels into runs, separately for every row. Every run starts with
+// a 32-bit word: with the highest bit set, the lower bits give how many times the following
+// pixel repeats; otherwise they give the number of following literal pixels. Returns the size
+// of the result, or 0 if it would be larger than capacity.
+std::size_t encode_runs(
+        const unsigned char* pixels,
+        int stride,
+        int width,
+        int height,
+        unsigned char* out,
+        std::size_t capacity);
+
+// Reverses encode_runs(), writing rows of the given stride.
+void decode_runs(
+        const unsigned char* data,
+        std::size_t size,
+        int stride,
+        int width,
+        int height,
+        unsigned char* pixels);
+
+} // namespace Sian::FrameArchive
+} // namespace Sian
+
+#endif
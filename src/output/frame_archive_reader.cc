@@ -0,0 +1,176 @@
+#include "frame_archive.hh"
+#include "frame_archive_reader.hh"
+#include "frame_sink.hh"
+#include "scene.hh"
+#include "utils.hh"
+
+#include <cairo.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstring> // std::memcpy, std::strerror
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Sian {
+
+using namespace FrameArchive;
+
+FrameArchiveReader::FrameArchiveReader(const std::string& path)
+    : path(path)
+{
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Cannot open frame archive %s: %s", path.c_str(), std::strerror(errno)));
+    }
+
+    memory = mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        memory = nullptr;
+        ::close(fd);
+        throw std::runtime_error(Utils::str_format(
+                "Cannot map frame archive %s: %s", path.c_str(), std::strerror(errno)));
+    }
+    mapped_size = sizeof(Header);
+
+    const Header* header = (const Header*) memory;
+    if (header->magic.load(std::memory_order_acquire) != FrameArchive::magic ||
+        header->version != version)
+    {
+        munmap(memory, mapped_size);
+        ::close(fd);
+        throw std::runtime_error(Utils::str_format(
+                "%s is not a frame archive of a compatible version.", path.c_str()));
+    }
+    update_mapping();
+}
+
+FrameArchiveReader::~FrameArchiveReader()
+{
+    if (memory)
+        munmap(memory, mapped_size);
+    if (fd >= 0)
+        ::close(fd);
+}
+
+void FrameArchiveReader::update_mapping()
+{
+    const Header* header = (const Header*) memory;
+    const std::uint64_t capacity = header->capacity.load(std::memory_order_acquire);
+    if (capacity == mapped_capacity)
+        return;
+
+    const std::size_t size = file_size(*header, capacity);
+    munmap(memory, mapped_size);
+    memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        memory = nullptr;
+        throw std::runtime_error(Utils::str_format(
+                "Cannot map frame archive %s: %s", path.c_str(), std::strerror(errno)));
+    }
+    mapped_size = size;
+    mapped_capacity = capacity;
+}
+
+int FrameArchiveReader::width() const
+{
+    return ((const Header*) memory)->width;
+}
+
+int FrameArchiveReader::height() const
+{
+    return ((const Header*) memory)->height;
+}
+
+cairo_format_t FrameArchiveReader::format() const
+{
+    return (cairo_format_t) ((const Header*) memory)->format;
+}
+
+double FrameArchiveReader::fps() const
+{
+    return ((const Header*) memory)->fps;
+}
+
+std::uint64_t FrameArchiveReader::frame_count() const
+{
+    return ((const Header*) memory)->frame_count.load(std::memory_order_acquire);
+}
+
+bool FrameArchiveReader::has_frame(std::uint64_t frame)
+{
+    if (frame >= frame_count())
+        return false;
+    update_mapping();
+    return slot(memory, frame)->state.load(std::memory_order_acquire) == READY;
+}
+
+void FrameArchiveReader::decode(std::uint64_t frame, cairo_surface_t* surface)
+{
+    if (!has_frame(frame))
+    {
+        throw std::out_of_range(Utils::str_format(
+                "Frame %llu of %s hasn't been written yet.",
+                (unsigned long long) frame, path.c_str()));
+    }
+
+    const Header* header = (const Header*) memory;
+    const SlotHeader* slot_header = slot(memory, frame);
+    const unsigned char* data = slot_data(memory, frame);
+    unsigned char* pixels = cairo_image_surface_get_data(surface);
+    const int stride = cairo_image_surface_get_stride(surface);
+
+    cairo_surface_flush(surface);
+    if (slot_header->encoding == RUNS)
+    {
+        decode_runs(data, slot_header->size, stride, header->width, header->height, pixels);
+    }
+    else
+    {
+        for (int y = 0; y < header->height; ++y)
+        {
+            std::memcpy(
+                    pixels + (std::size_t) y * stride,
+                    data + (std::size_t) y * header->stride,
+                    (std::size_t) header->width * 4);
+        }
+    }
+    cairo_surface_mark_dirty(surface);
+}
+
+Scene::Snapshot FrameArchiveReader::read(std::uint64_t frame)
+{
+    std::shared_ptr<cairo_surface_t> surface(
+            cairo_image_surface_create(format(), width(), height()),
+            cairo_surface_destroy);
+    decode(frame, surface.get());
+    return Scene::Snapshot(surface);
+}
+
+void FrameArchiveReader::feed(FrameSink& sink)
+{
+    // every frame gets a surface of its own, sinks may keep the snapshots they are given
+    // (and the mapping goes away when the archive grows)
+    const std::uint64_t count = frame_count();
+    for (std::uint64_t frame = 0; frame < count; ++frame)
+    {
+        if (!has_frame(frame))
+        {
+            throw std::runtime_error(Utils::str_format(
+                    "Frame %llu of %s is missing.", (unsigned long long) frame, path.c_str()));
+        }
+        sink.write(read(frame));
+    }
+}
+
+} // namespace Sian
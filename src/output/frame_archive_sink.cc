@@ -0,0 +1,340 @@
+#include "ffmpeg_stream_sink.hh"
+#include "frame_archive.hh"
+#include "frame_archive_reader.hh"
+#include "frame_archive_sink.hh"
+#include "scene.hh"
+#include "utils.hh"
+
+#include <cairo.h>
+
+#include <algorithm> // std::max, std::min
+#include <atomic>
+#include <cerrno>
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstring> // std::memcpy, std::strerror
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Sian {
+
+using namespace FrameArchive;
+
+namespace {
+
+// number of slots a new archive has room for
+const std::uint64_t initial_capacity = 64;
+
+// Holds an exclusive lock of the archive file, serializing its initialization and growth
+// among all writers.
+class FileLock
+{
+public:
+    explicit FileLock(int fd)
+        : fd(fd)
+    {
+        flock(fd, LOCK_EX);
+    }
+
+    ~FileLock()
+    {
+        flock(fd, LOCK_UN);
+    }
+
+private:
+    int fd;
+};
+
+void update_maximum(std::atomic<std::uint64_t>& value, std::uint64_t candidate)
+{
+    std::uint64_t current = value.load(std::memory_order_relaxed);
+    while (current < candidate &&
+           !value.compare_exchange_weak(current, candidate, std::memory_order_release))
+    { }
+}
+
+} // namespace Sian::{anonymous}
+
+FrameArchiveSink::FrameArchiveSink(const Config& config)
+    : FrameArchiveSink(config.frame_archive, config.fps, true, 0, 1, config.output_file)
+{
+    if (config.resume)
+        throw std::invalid_argument("Renders into a frame archive cannot be resumed.");
+    // the only writer, frames left by an earlier render are overwritten
+    shared = false;
+}
+
+FrameArchiveSink::FrameArchiveSink(
+        const std::string& path,
+        double fps,
+        bool compress,
+        std::uint64_t first_frame,
+        std::uint64_t frame_step,
+        const std::string& output_file)
+    : path(path),
+      fps(fps),
+      compress(compress),
+      frame_step(frame_step),
+      output_file(output_file),
+      next_frame(first_frame)
+{
+    if (frame_step == 0)
+        throw std::invalid_argument("The step between frames of an archive has to be positive.");
+}
+
+FrameArchiveSink::~FrameArchiveSink()
+{
+    close();
+}
+
+void FrameArchiveSink::open(int width, int height, cairo_format_t format)
+{
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Cannot open frame archive %s: %s", path.c_str(), std::strerror(errno)));
+    }
+
+    FileLock lock(fd);
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Cannot open frame archive %s: %s", path.c_str(), std::strerror(errno)));
+    }
+
+    if (!shared && info.st_size != 0)
+    {
+        if (ftruncate(fd, 0) != 0)
+        {
+            throw std::runtime_error(Utils::str_format(
+                    "Cannot clear frame archive %s: %s", path.c_str(), std::strerror(errno)));
+        }
+        info.st_size = 0;
+    }
+
+    // the first writer lays out the file
+    if (info.st_size == 0)
+    {
+        Header layout;
+        layout.stride = cairo_format_stride_for_width(format, width);
+        layout.slot_size = aligned(
+                slot_data_offset + (std::size_t) layout.stride * height,
+                slot_alignment);
+        layout.slots_offset = aligned(sizeof(Header), slot_alignment);
+
+        // the file is sparse, so its slots take no space until they're written
+        if (ftruncate(fd, file_size(layout, initial_capacity)) != 0)
+        {
+            throw std::runtime_error(Utils::str_format(
+                    "Cannot allocate frame archive %s: %s", path.c_str(), std::strerror(errno)));
+        }
+        map(0);
+
+        Header* header = new (memory) Header();
+        header->version = version;
+        header->width = width;
+        header->height = height;
+        header->stride = layout.stride;
+        header->format = format;
+        header->fps = fps;
+        header->slot_size = layout.slot_size;
+        header->slots_offset = layout.slots_offset;
+        header->capacity.store(initial_capacity, std::memory_order_relaxed);
+        header->frame_count.store(0, std::memory_order_relaxed);
+        header->magic.store(FrameArchive::magic, std::memory_order_release);
+    }
+    else
+    {
+        map(0);
+    }
+
+    const Header* header = (const Header*) memory;
+    if (header->magic.load(std::memory_order_acquire) != FrameArchive::magic ||
+        header->version != version)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "%s is not a frame archive of a compatible version.", path.c_str()));
+    }
+    if (header->fps != fps)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Frame archive %s holds frames at %g fps, not %g fps.",
+                path.c_str(), header->fps, fps));
+    }
+    map(header->capacity.load(std::memory_order_acquire));
+}
+
+void FrameArchiveSink::map(std::uint64_t capacity)
+{
+    // the header, mapped first, tells how large the slots are
+    std::size_t size = sizeof(Header);
+    if (capacity > 0)
+        size = file_size(*(const Header*) memory, capacity);
+
+    if (memory)
+        munmap(memory, mapped_size);
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        memory = nullptr;
+        throw std::runtime_error(Utils::str_format(
+                "Cannot map frame archive %s: %s", path.c_str(), std::strerror(errno)));
+    }
+    mapped_size = size;
+    mapped_capacity = capacity;
+}
+
+void FrameArchiveSink::reserve(std::uint64_t frame)
+{
+    if (frame < mapped_capacity)
+        return;
+
+    Header* header = (Header*) memory;
+    if (frame >= header->capacity.load(std::memory_order_acquire))
+    {
+        FileLock lock(fd);
+        // another writer may have grown the file in the meantime
+        const std::uint64_t capacity = header->capacity.load(std::memory_order_acquire);
+        if (frame >= capacity)
+        {
+            const std::uint64_t new_capacity = std::max(2 * capacity, frame + 1);
+            if (ftruncate(fd, file_size(*header, new_capacity)) != 0)
+            {
+                throw std::runtime_error(Utils::str_format(
+                        "Cannot grow frame archive %s: %s", path.c_str(), std::strerror(errno)));
+            }
+            header->capacity.store(new_capacity, std::memory_order_release);
+        }
+    }
+    map(header->capacity.load(std::memory_order_acquire));
+}
+
+void FrameArchiveSink::close()
+{
+    if (memory)
+    {
+        munmap(memory, mapped_size);
+        memory = nullptr;
+    }
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+unsigned char* FrameArchiveSink::frame_buffer(
+        int width,
+        int height,
+        cairo_format_t format,
+        int& stride)
+{
+    if (!memory)
+        open(width, height, format);
+
+    const Header* header = (const Header*) memory;
+    if (width != header->width || height != header->height || format != header->format)
+    {
+        throw std::logic_error(Utils::str_format(
+                "All frames stored in %s must have the same dimensions and format.",
+                path.c_str()));
+    }
+
+    // compressed frames are drawn elsewhere and encoded into the slot by write()
+    if (compress)
+        return nullptr;
+
+    stride = header->stride;
+    // the archive may be remapped here
+    reserve(next_frame);
+    if (!frame_begun)
+    {
+        slot(memory, next_frame)->state.store(WRITING, std::memory_order_relaxed);
+        frame_begun = true;
+    }
+    return slot_data(memory, next_frame);
+}
+
+void FrameArchiveSink::write(const Scene::Snapshot& frame)
+{
+    const Scene::Snapshot::Pixels pixels = frame.pixels();
+    if (pixels.format != CAIRO_FORMAT_ARGB32 && pixels.format != CAIRO_FORMAT_RGB24)
+        throw std::invalid_argument("Only frames with 32 bits per pixel can be archived.");
+
+    int stride = 0;
+    frame_buffer(pixels.width, pixels.height, pixels.format, stride);
+    reserve(next_frame);
+
+    Header* header = (Header*) memory;
+    SlotHeader* slot_header = slot(memory, next_frame);
+    unsigned char* data = slot_data(memory, next_frame);
+    slot_header->state.store(WRITING, std::memory_order_relaxed);
+
+    std::size_t size = 0;
+    if (compress)
+    {
+        size = encode_runs(
+                pixels.data,
+                pixels.stride,
+                pixels.width,
+                pixels.height,
+                data,
+                header->slot_size - slot_data_offset);
+    }
+    if (size > 0)
+    {
+        slot_header->encoding = RUNS;
+    }
+    else
+    {
+        // frames that haven't been drawn directly into the slot, or compress badly, are copied
+        if (pixels.data != data)
+        {
+            const std::size_t row_size = std::min(header->stride, pixels.stride);
+            for (int y = 0; y < pixels.height; ++y)
+            {
+                std::memcpy(
+                        data + (std::size_t) y * header->stride,
+                        pixels.data + (std::size_t) y * pixels.stride,
+                        row_size);
+            }
+        }
+        slot_header->encoding = RAW;
+        size = (std::size_t) header->stride * header->height;
+    }
+    slot_header->size = size;
+    slot_header->state.store(READY, std::memory_order_release);
+    update_maximum(header->frame_count, next_frame + 1);
+
+    next_frame += frame_step;
+    frame_begun = false;
+}
+
+void FrameArchiveSink::finish()
+{
+    if (!memory)
+        return;
+
+    if (msync(memory, mapped_size, MS_SYNC) != 0)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Cannot write frame archive %s: %s", path.c_str(), std::strerror(errno)));
+    }
+    if (output_file.empty())
+        return;
+
+    FrameArchiveReader reader(path);
+    FfmpegStreamSink encoder(output_file, reader.fps());
+    reader.feed(encoder);
+    encoder.finish();
+}
+
+} // namespace Sian
@@ -0,0 +1,30 @@
+#include "frame_sink.hh"
+
+#include <cstdint>
+#include <stdexcept> // std::logic_error
+
+namespace Sian {
+
+FrameSink::~FrameSink()
+{ }
+
+unsigned char* FrameSink::frame_buffer(int width, int height, cairo_format_t format, int& stride)
+{
+    return nullptr;
+}
+
+void FrameSink::set_render_settings(const RenderSettings& settings)
+{ }
+
+std::uint64_t FrameSink::completed_frames()
+{
+    return 0;
+}
+
+void FrameSink::skip_frames(std::uint64_t count)
+{
+    if (count > 0)
+        throw std::logic_error("The sink cannot skip frames it hasn't written.");
+}
+
+} // namespace Sian
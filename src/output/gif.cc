@@ -0,0 +1,375 @@
+#include "gif.hh"
+
+#include <algorithm> // std::max, std::min, std::sort, std::fill
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <vector>
+
+namespace Sian {
+namespace Gif {
+
+namespace {
+
+const int max_code_size = 12;
+const std::size_t max_codes = 1 << max_code_size;
+
+// must be a power of two
+const std::size_t mapper_cache_size = 4096;
+const std::uint32_t cache_valid = 0x80000000u;
+
+// Colors are counted in 5 bits per channel while looking for the median cut.
+int bin_of(std::uint32_t color)
+{
+    return (color >> 9 & 0x7c00) | (color >> 6 & 0x3e0) | (color >> 3 & 0x1f);
+}
+
+int bin_channel(int bin, int channel)
+{
+    return bin >> (10 - 5 * channel) & 0x1f;
+}
+
+struct Bin
+{
+    int index;
+    std::uint64_t count = 0;
+    std::uint64_t sums[3] = {0, 0, 0};
+};
+
+struct Box
+{
+    // range of bins belonging to the box
+    std::size_t begin;
+    std::size_t end;
+    std::uint64_t count;
+    // channel with the largest range of values and its range
+    int channel;
+    int range;
+};
+
+Box make_box(const std::vector<Bin>& bins, std::size_t begin, std::size_t end)
+{
+    Box box = {begin, end, 0, 0, -1};
+    int low[3] = {31, 31, 31};
+    int high[3] = {0, 0, 0};
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        box.count += bins[i].count;
+        for (int c = 0; c < 3; ++c)
+        {
+            low[c] = std::min(low[c], bin_channel(bins[i].index, c));
+            high[c] = std::max(high[c], bin_channel(bins[i].index, c));
+        }
+    }
+    for (int c = 0; c < 3; ++c)
+    {
+        if (high[c] - low[c] > box.range)
+        {
+            box.channel = c;
+            box.range = high[c] - low[c];
+        }
+    }
+    return box;
+}
+
+Palette median_cut(const std::vector<std::uint32_t>& colors, int max_colors)
+{
+    std::vector<Bin> histogram(1 << 15);
+    for (std::uint32_t color : colors)
+    {
+        Bin& bin = histogram[bin_of(color)];
+        ++bin.count;
+        bin.sums[0] += color >> 16 & 0xff;
+        bin.sums[1] += color >> 8 & 0xff;
+        bin.sums[2] += color & 0xff;
+    }
+    std::vector<Bin> bins;
+    for (std::size_t i = 0; i < histogram.size(); ++i)
+    {
+        if (histogram[i].count > 0)
+        {
+            bins.push_back(histogram[i]);
+            bins.back().index = i;
+        }
+    }
+
+    // the box spanning the largest range of a channel is split at the median of the colors
+    std::vector<Box> boxes = {make_box(bins, 0, bins.size())};
+    while ((int) boxes.size() < max_colors)
+    {
+        std::size_t widest = 0;
+        for (std::size_t i = 1; i < boxes.size(); ++i)
+        {
+            if (boxes[i].range > boxes[widest].range ||
+                (boxes[i].range == boxes[widest].range && boxes[i].count > boxes[widest].count))
+            {
+                widest = i;
+            }
+        }
+        const Box box = boxes[widest];
+        if (box.range <= 0)
+            break;
+
+        std::sort(
+                bins.begin() + box.begin,
+                bins.begin() + box.end,
+                [&box](const Bin& a, const Bin& b)
+                {
+                    return bin_channel(a.index, box.channel) < bin_channel(b.index, box.channel);
+                });
+        std::size_t split = box.begin;
+        std::uint64_t below = 0;
+        while (split < box.end - 1 && 2 * (below + bins[split].count) <= box.count)
+        {
+            below += bins[split++].count;
+        }
+        split = std::max(split, box.begin + 1);
+
+        boxes[widest] = make_box(bins, box.begin, split);
+        boxes.push_back(make_box(bins, split, box.end));
+    }
+
+    Palette palette;
+    for (const Box& box : boxes)
+    {
+        std::uint64_t sums[3] = {0, 0, 0};
+        for (std::size_t i = box.begin; i < box.end; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                sums[c] += bins[i].sums[c];
+        }
+        const std::uint64_t half = box.count / 2;
+        palette.push_back(
+                (std::uint32_t) ((sums[0] + half) / box.count) << 16 |
+                (std::uint32_t) ((sums[1] + half) / box.count) << 8 |
+                (std::uint32_t) ((sums[2] + half) / box.count));
+    }
+    return palette;
+}
+
+// Collects the distinct colors, or returns false if there are more than max_colors of them.
+bool distinct_colors(const std::vector<std::uint32_t>& colors, int max_colors, Palette& palette)
+{
+    // open addressing with a table at most half full
+    const std::size_t table_size = 1024;
+    const std::uint32_t empty = 0xffffffffu;
+    std::vector<std::uint32_t> table(table_size, empty);
+    std::uint32_t previous = empty;
+    for (std::uint32_t color : colors)
+    {
+        if (color == previous)
+            continue;
+        previous = color;
+
+        std::size_t slot = (color * 2654435761u) & (table_size - 1);
+        while (table[slot] != empty && table[slot] != color)
+        {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table[slot] == empty)
+        {
+            if ((int) palette.size() == max_colors)
+                return false;
+            table[slot] = color;
+            palette.push_back(color);
+        }
+    }
+    return true;
+}
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<unsigned char>& out)
+        : out(out)
+    { }
+
+    void write(unsigned code, int size)
+    {
+        buffer |= (std::uint32_t) code << bit_count;
+        bit_count += size;
+        while (bit_count >= 8)
+        {
+            push(buffer & 0xff);
+            buffer >>= 8;
+            bit_count -= 8;
+        }
+    }
+
+    // Writes the remaining bits and the terminating empty sub-block.
+    void finish()
+    {
+        if (bit_count > 0)
+            push(buffer & 0xff);
+        flush_block();
+        out.push_back(0);
+    }
+
+private:
+    void push(unsigned char byte)
+    {
+        block[block_size++] = byte;
+        if (block_size == 255)
+            flush_block();
+    }
+
+    void flush_block()
+    {
+        if (block_size == 0)
+            return;
+        out.push_back(block_size);
+        out.insert(out.end(), block, block + block_size);
+        block_size = 0;
+    }
+
+    std::vector<unsigned char>& out;
+    std::uint32_t buffer = 0;
+    int bit_count = 0;
+    unsigned char block[255];
+    int block_size = 0;
+};
+
+} // namespace Sian::Gif::{anonymous}
+
+Palette quantize(const std::vector<std::uint32_t>& colors, int max_colors)
+{
+    Palette palette;
+    if (distinct_colors(colors, max_colors, palette))
+        return palette;
+    return median_cut(colors, max_colors);
+}
+
+PaletteMapper::PaletteMapper(const Palette& palette)
+    : cached_colors(mapper_cache_size, 0),
+      cached_indices(mapper_cache_size, 0)
+{
+    for (std::uint32_t color : palette)
+    {
+        red.push_back(color >> 16 & 0xff);
+        green.push_back(color >> 8 & 0xff);
+        blue.push_back(color & 0xff);
+    }
+}
+
+unsigned char PaletteMapper::index_of(std::uint32_t color)
+{
+    color &= 0xffffff;
+    const std::size_t slot = (color * 2654435761u) >> 20 & (mapper_cache_size - 1);
+    if (cached_colors[slot] != (color | cache_valid))
+    {
+        cached_colors[slot] = color | cache_valid;
+        cached_indices[slot] = nearest(color);
+    }
+    return cached_indices[slot];
+}
+
+unsigned char PaletteMapper::nearest(std::uint32_t color) const
+{
+    const int r = color >> 16 & 0xff;
+    const int g = color >> 8 & 0xff;
+    const int b = color & 0xff;
+
+    // distances are computed for all colors at once, which compilers vectorize
+    const std::size_t count = red.size();
+    int distances[256];
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const int dr = red[i] - r;
+        const int dg = green[i] - g;
+        const int db = blue[i] - b;
+        distances[i] = dr * dr + dg * dg + db * db;
+    }
+
+    std::size_t best = 0;
+    for (std::size_t i = 1; i < count; ++i)
+    {
+        if (distances[i] < distances[best])
+            best = i;
+    }
+    return best;
+}
+
+int index_bits(std::size_t color_count)
+{
+    // color tables have at least two colors
+    int bits = 1;
+    while (((std::size_t) 1 << bits) < color_count)
+    {
+        ++bits;
+    }
+    return bits;
+}
+
+void lzw_encode(
+        const unsigned char* indices,
+        std::size_t count,
+        int min_code_size,
+        std::vector<unsigned char>& out)
+{
+    // images must use at least 2-bit codes
+    min_code_size = std::max(min_code_size, 2);
+    out.push_back(min_code_size);
+    BitWriter writer(out);
+
+    const unsigned clear_code = 1u << min_code_size;
+    const unsigned end_code = clear_code + 1;
+    int code_size = min_code_size + 1;
+    unsigned next_code = end_code + 1;
+
+    // the dictionary maps a code followed by an index to a longer code
+    const std::size_t table_size = 2 * max_codes;
+    std::vector<std::int32_t> keys(table_size, -1);
+    std::vector<std::uint16_t> codes(table_size);
+
+    auto emit = [&](unsigned code)
+    {
+        writer.write(code, code_size);
+        if (next_code > (1u << code_size) - 1 && code_size < max_code_size)
+            ++code_size;
+    };
+
+    writer.write(clear_code, code_size);
+    if (count == 0)
+    {
+        writer.write(end_code, code_size);
+        writer.finish();
+        return;
+    }
+
+    unsigned prefix = indices[0];
+    for (std::size_t i = 1; i < count; ++i)
+    {
+        const std::int32_t key = (std::int32_t) (prefix << 8 | indices[i]);
+        std::size_t slot = ((std::uint32_t) key * 2654435761u >> 19) & (table_size - 1);
+        while (keys[slot] != -1 && keys[slot] != key)
+        {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (keys[slot] == key)
+        {
+            prefix = codes[slot];
+            continue;
+        }
+
+        emit(prefix);
+        if (next_code < max_codes)
+        {
+            keys[slot] = key;
+            codes[slot] = next_code++;
+        }
+        else
+        {
+            // the dictionary is full, so it starts over
+            writer.write(clear_code, code_size);
+            std::fill(keys.begin(), keys.end(), -1);
+            code_size = min_code_size + 1;
+            next_code = end_code + 1;
+        }
+        prefix = indices[i];
+    }
+    emit(prefix);
+    writer.write(end_code, code_size);
+    writer.finish();
+}
+
+} // namespace Sian::Gif
+} // namespace Sian
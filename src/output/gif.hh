@@ -0,0 +1,51 @@
+#ifndef GIF_HH
+#define GIF_HH
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <vector>
+
+namespace Sian {
+namespace Gif {
+
+// Colors of a palette as 0xRRGGBB. A GIF palette holds at most 256 colors.
+using Palette = std::vector<std::uint32_t>;
+
+// Chooses at most max_colors colors representing the given colors (as 0xRRGGBB). When there
+// are few enough distinct colors, they are all used exactly, otherwise they are reduced by
+// median cut.
+Palette quantize(const std::vector<std::uint32_t>& colors, int max_colors);
+
+// Finds the closest color of a palette to given colors. Colors that have been looked up
+// recently are remembered, so that flat areas of frames are mapped quickly.
+class PaletteMapper
+{
+public:
+    explicit PaletteMapper(const Palette& palette);
+
+    unsigned char index_of(std::uint32_t color);
+
+private:
+    unsigned char nearest(std::uint32_t color) const;
+
+    std::vector<int> red, green, blue;
+    // direct-mapped cache of colors (with the highest bit set to mark valid entries) and indices
+    std::vector<std::uint32_t> cached_colors;
+    std::vector<unsigned char> cached_indices;
+};
+
+// Number of bits of the indices of a palette with the given number of colors, as GIF needs it.
+int index_bits(std::size_t color_count);
+
+// Compresses indices into a palette by LZW as GIF images store them, including the minimal
+// code size and the data sub-blocks, and appends them to out.
+void lzw_encode(
+        const unsigned char* indices,
+        std::size_t count,
+        int min_code_size,
+        std::vector<unsigned char>& out);
+
+} // namespace Sian::Gif
+} // namespace Sian
+
+#endif
@@ -0,0 +1,271 @@
+#include "color.hh"
+#include "gif.hh"
+#include "gif_sink.hh"
+#include "logger.hh"
+#include "scene.hh"
+#include "utils.hh"
+
+#include <cairo.h>
+
+#include <algorithm> // std::min, std::max
+#include <cmath> // std::lround
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstdio> // std::fopen, std::fwrite, std::fclose
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Sian {
+
+namespace {
+
+// the index after the last color of a palette marks unchanged pixels
+const int max_palette_size = 255;
+
+// offset of the delay in an encoded frame, which starts with the graphic control extension
+const std::size_t delay_offset = 4;
+
+void append_u16(std::vector<unsigned char>& out, int value)
+{
+    out.push_back(value & 0xff);
+    out.push_back(value >> 8 & 0xff);
+}
+
+void append_color_table(std::vector<unsigned char>& out, const std::vector<std::uint32_t>& palette)
+{
+    // the table is padded to a power of two
+    const std::size_t size = (std::size_t) 1 << Gif::index_bits(palette.size() + 1);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const std::uint32_t color = i < palette.size() ? palette[i] : 0;
+        out.push_back(color >> 16 & 0xff);
+        out.push_back(color >> 8 & 0xff);
+        out.push_back(color & 0xff);
+    }
+}
+
+} // namespace Sian::{anonymous}
+
+GifSink::GifSink(const Config& config)
+    : GifSink(config.output_file, config.fps)
+{ }
+
+GifSink::GifSink(
+        const std::string& output_file,
+        double fps,
+        const std::vector<Color>& colors,
+        int loop_count)
+    : output_file(output_file),
+      fps(fps),
+      loop_count(loop_count)
+{
+    if ((int) colors.size() > max_palette_size)
+        throw std::invalid_argument("A GIF palette can hold at most 255 colors.");
+
+    for (const Color& color : colors)
+    {
+        palette.push_back(
+                (std::uint32_t) std::lround(color.red()) << 16 |
+                (std::uint32_t) std::lround(color.green()) << 8 |
+                (std::uint32_t) std::lround(color.blue()));
+    }
+    if (!palette.empty())
+        palette_mapper = std::make_unique<Gif::PaletteMapper>(palette);
+}
+
+GifSink::~GifSink()
+{
+    if (file)
+        std::fclose(file);
+}
+
+int GifSink::frame_delay(long frame) const
+{
+    // rounding the time of every frame keeps the animation from drifting
+    return (int) (std::lround((frame + 1) * 100 / fps) - std::lround(frame * 100 / fps));
+}
+
+void GifSink::open(int frame_width, int frame_height)
+{
+    if (frame_width > 0xffff || frame_height > 0xffff)
+        throw std::invalid_argument("GIF images can be at most 65535 pixels wide and high.");
+
+    width = frame_width;
+    height = frame_height;
+    previous.assign((std::size_t) width * height, 0);
+
+    const std::string filename = Utils::with_extension(output_file, ".gif");
+    Logger::info("Writing " + filename);
+    file = std::fopen(filename.c_str(), "wb");
+    if (!file)
+        throw std::runtime_error(Utils::str_format("Cannot create %s.", filename.c_str()));
+
+    std::vector<unsigned char> header = {'G', 'I', 'F', '8', '9', 'a'};
+    append_u16(header, width);
+    append_u16(header, height);
+    header.push_back(palette.empty() ? 0x70 : 0xf0 | (Gif::index_bits(palette.size() + 1) - 1));
+    header.push_back(0); // background color
+    header.push_back(0); // pixel aspect ratio
+    if (!palette.empty())
+        append_color_table(header, palette);
+
+    // the application extension of Netscape makes the animation loop
+    const unsigned char looping[] = {
+        0x21, 0xff, 0x0b, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01
+    };
+    header.insert(header.end(), looping, looping + sizeof(looping));
+    append_u16(header, loop_count);
+    header.push_back(0);
+
+    if (std::fwrite(header.data(), 1, header.size(), file) != header.size())
+        throw std::runtime_error("Writing the GIF failed.");
+}
+
+void GifSink::flush_pending()
+{
+    if (pending.empty())
+        return;
+
+    pending[delay_offset] = pending_delay & 0xff;
+    pending[delay_offset + 1] = pending_delay >> 8 & 0xff;
+    if (std::fwrite(pending.data(), 1, pending.size(), file) != pending.size())
+        throw std::runtime_error("Writing the GIF failed.");
+    pending.clear();
+}
+
+void GifSink::write(const Scene::Snapshot& frame)
+{
+    const Scene::Snapshot::Pixels pixels = frame.pixels();
+    if (pixels.format != CAIRO_FORMAT_ARGB32 && pixels.format != CAIRO_FORMAT_RGB24)
+        throw std::invalid_argument("Only frames with 32 bits per pixel can be saved as GIF.");
+
+    if (!file)
+    {
+        open(pixels.width, pixels.height);
+    }
+    else if (pixels.width != width || pixels.height != height)
+    {
+        throw std::logic_error(Utils::str_format(
+                "All frames of %s must have the same dimensions.",
+                output_file.c_str()));
+    }
+
+    // premultiplied colors are the colors composited over black, so alpha is just left out
+    auto color_at = [&pixels](int x, int y)
+    {
+        return ((const std::uint32_t*) (pixels.data + (std::size_t) y * pixels.stride))[x] &
+               0xffffff;
+    };
+    const bool first_frame = frame_count == 0;
+
+    // the rectangle of pixels that changed
+    int left = width;
+    int right = -1;
+    int top = height;
+    int bottom = -1;
+    for (int y = 0; y < height; ++y)
+    {
+        const std::uint32_t* previous_row = previous.data() + (std::size_t) y * width;
+        for (int x = 0; x < width; ++x)
+        {
+            if (first_frame || color_at(x, y) != previous_row[x])
+            {
+                left = std::min(left, x);
+                right = std::max(right, x);
+                top = std::min(top, y);
+                bottom = std::max(bottom, y);
+            }
+        }
+    }
+
+    const int delay = frame_delay(frame_count++);
+    if (right < 0)
+    {
+        pending_delay += delay;
+        return;
+    }
+    flush_pending();
+
+    const int rect_width = right - left + 1;
+    const int rect_height = bottom - top + 1;
+    std::vector<std::uint32_t> changed_colors;
+    for (int y = top; y <= bottom; ++y)
+    {
+        for (int x = left; x <= right; ++x)
+        {
+            const std::uint32_t color = color_at(x, y);
+            if (first_frame || color != previous[(std::size_t) y * width + x])
+                changed_colors.push_back(color);
+        }
+    }
+
+    std::unique_ptr<Gif::PaletteMapper> local_mapper;
+    Gif::Palette local_palette;
+    if (!palette_mapper)
+    {
+        local_palette = Gif::quantize(changed_colors, max_palette_size);
+        local_mapper = std::make_unique<Gif::PaletteMapper>(local_palette);
+    }
+    const Gif::Palette& frame_palette = palette_mapper ? palette : local_palette;
+    Gif::PaletteMapper& mapper = palette_mapper ? *palette_mapper : *local_mapper;
+    const int transparent = frame_palette.size();
+    const int bits = Gif::index_bits(frame_palette.size() + 1);
+
+    std::vector<unsigned char> indices;
+    indices.reserve((std::size_t) rect_width * rect_height);
+    for (int y = top; y <= bottom; ++y)
+    {
+        std::uint32_t* previous_row = previous.data() + (std::size_t) y * width;
+        for (int x = left; x <= right; ++x)
+        {
+            const std::uint32_t color = color_at(x, y);
+            if (!first_frame && color == previous_row[x])
+            {
+                indices.push_back(transparent);
+            }
+            else
+            {
+                indices.push_back(mapper.index_of(color));
+                previous_row[x] = color;
+            }
+        }
+    }
+
+    // graphic control extension: the frame is kept when the next one is drawn over it
+    pending = {0x21, 0xf9, 0x04, 0x04 | 0x01, 0, 0, (unsigned char) transparent, 0};
+    pending_delay = delay;
+
+    pending.push_back(0x2c);
+    append_u16(pending, left);
+    append_u16(pending, top);
+    append_u16(pending, rect_width);
+    append_u16(pending, rect_height);
+    if (palette_mapper)
+    {
+        pending.push_back(0);
+    }
+    else
+    {
+        pending.push_back(0x80 | (bits - 1));
+        append_color_table(pending, local_palette);
+    }
+    Gif::lzw_encode(indices.data(), indices.size(), bits, pending);
+}
+
+void GifSink::finish()
+{
+    if (!file)
+        return;
+
+    flush_pending();
+    const unsigned char trailer = 0x3b;
+    const bool written = std::fwrite(&trailer, 1, 1, file) == 1;
+    const bool closed = std::fclose(file) == 0;
+    file = nullptr;
+    if (!written || !closed)
+        throw std::runtime_error("Writing the GIF failed.");
+}
+
+} // namespace Sian
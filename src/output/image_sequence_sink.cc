@@ -0,0 +1,354 @@
+#include "file_writer.hh"
+#include "image_sequence_sink.hh"
+#include "logger.hh"
+#include "scene.hh"
+#include "utils.hh"
+
+#include <zlib.h>
+
+#include <algorithm> // std::min
+#include <cctype> // std::isdigit
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib> // std::strtoull, std::system
+#include <cstring> // std::strerror
+#include <dirent.h>
+#include <fstream>
+#include <iterator> // std::istreambuf_iterator
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept> // std::invalid_argument
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <vector>
+
+namespace Sian {
+
+namespace {
+
+// starts the line of the manifest describing the render
+const char* const identity_prefix = "# render ";
+
+std::uint32_t checksum(const unsigned char* data, std::size_t size)
+{
+    return crc32(crc32(0L, Z_NULL, 0), data, size);
+}
+
+} // namespace Sian::{anonymous}
+
+ImageSequenceSink::ImageSequenceSink(const Config& config)
+    : ImageSequenceSink(
+            config.temporary_directory,
+            config.output_file,
+            config.fps,
+            config.require_empty_tmp_dir,
+            config.image_format,
+            config.png_options,
+            config.writer_options,
+            config.resume)
+{ }
+
+ImageSequenceSink::ImageSequenceSink(
+        const std::string& directory,
+        const std::string& output_file,
+        double fps,
+        bool require_empty_directory,
+        ImageFormat format,
+        const PngOptions& png_options,
+        const WriterOptions& writer_options,
+        bool resume)
+    : directory(directory),
+      output_file(output_file),
+      fps(fps),
+      require_empty_directory(require_empty_directory),
+      resume(resume),
+      format(format),
+      png_options(png_options),
+      direct_io(writer_options.direct_io)
+{
+    struct stat info;
+    if (stat(directory.c_str(), &info) != 0 || !(info.st_mode & S_IFDIR))
+    {
+        throw std::invalid_argument(Utils::str_format(
+                "Cannot access directory %s/. Please make sure it exists.",
+                directory.c_str()));
+    }
+    if (resume)
+        load_manifest();
+    else if (require_empty_directory)
+        check_directory_empty();
+
+    if (writer_options.threads > 0)
+    {
+        writer = std::make_unique<AsyncFileWriter>(
+                writer_options.threads,
+                writer_options.queue_depth);
+    }
+}
+
+ImageSequenceSink::~ImageSequenceSink()
+{
+    // pending jobs still record their frames
+    writer.reset();
+    if (manifest)
+        std::fclose(manifest);
+}
+
+std::vector<std::uint64_t> ImageSequenceSink::images_in_directory() const
+{
+    DIR* dir = opendir(directory.c_str());
+    if (!dir)
+    {
+        throw std::invalid_argument(Utils::str_format(
+                "Cannot access directory %s/. Please make sure it exists.",
+                directory.c_str()));
+    }
+
+    // images of frames are named by their number and the extension of the format
+    const std::string image_extension = extension();
+    std::vector<std::uint64_t> frames;
+    while (dirent* entry = readdir(dir))
+    {
+        const std::string name = entry->d_name;
+        const std::size_t digits = name.size() - std::min(name.size(), image_extension.size());
+        bool numbered = digits > 0 && name.compare(digits, std::string::npos, image_extension) == 0;
+        for (std::size_t i = 0; numbered && i < digits; ++i)
+        {
+            numbered = std::isdigit((unsigned char) name[i]);
+        }
+        // numbers too large for a frame saturate, they are past any kept frame anyway
+        if (numbered)
+            frames.push_back(std::strtoull(name.c_str(), nullptr, 10));
+    }
+    closedir(dir);
+    return frames;
+}
+
+void ImageSequenceSink::check_directory_empty() const
+{
+    if (!images_in_directory().empty())
+    {
+        throw std::invalid_argument(Utils::str_format(
+                "The temporary directory %s/ is not empty. Please remove its content or "
+                "run the program with -r option to state that you wish to do it automatically.",
+                directory.c_str()));
+    }
+}
+
+std::string ImageSequenceSink::extension() const
+{
+    return format == ImageFormat::QOI ? ".qoi" : ".png";
+}
+
+std::string ImageSequenceSink::image_path(std::uint64_t frame) const
+{
+    return directory + "/" + std::to_string(frame) + extension();
+}
+
+std::string ImageSequenceSink::manifest_path() const
+{
+    return directory + "/manifest.txt";
+}
+
+void ImageSequenceSink::load_manifest()
+{
+    std::ifstream file(manifest_path());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        // the last line may have been cut short by the interruption
+        std::istringstream fields(line);
+        std::uint64_t frame;
+        ManifestEntry entry;
+        if (line.compare(0, std::strlen(identity_prefix), identity_prefix) == 0)
+            resumed_identity = line.substr(std::strlen(identity_prefix));
+        if (line.empty() || line[0] == '#' || !(fields >> frame >> entry.size >> entry.checksum))
+            continue;
+        intact_frames[frame] = entry;
+    }
+
+    for (auto it = intact_frames.begin(); it != intact_frames.end(); )
+    {
+        std::ifstream image(image_path(it->first), std::ios::binary);
+        const std::vector<unsigned char> data(
+                (std::istreambuf_iterator<char>(image)),
+                std::istreambuf_iterator<char>());
+        if (data.size() == it->second.size &&
+            checksum(data.data(), data.size()) == it->second.checksum)
+            ++it;
+        else
+            it = intact_frames.erase(it);
+    }
+}
+
+void ImageSequenceSink::prepare_directory()
+{
+    // a resumed render keeping no images starts like a new one
+    if (resume && output_counter == 0 && require_empty_directory)
+        check_directory_empty();
+
+    // FFmpeg would append images left after the kept ones to the video
+    for (std::uint64_t frame : images_in_directory())
+    {
+        if (frame < output_counter)
+            continue;
+        const std::string path = image_path(frame);
+        if (std::remove(path.c_str()) != 0 && errno != ENOENT)
+        {
+            throw std::runtime_error(Utils::str_format(
+                    "Cannot remove %s: %s", path.c_str(), std::strerror(errno)));
+        }
+    }
+}
+
+void ImageSequenceSink::open_manifest()
+{
+    // written aside and renamed, so that an interruption never leaves a partial manifest
+    const std::string path = manifest_path();
+    const std::string new_path = path + ".new";
+    std::FILE* file = std::fopen(new_path.c_str(), "w");
+    if (!file)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Cannot write %s: %s", new_path.c_str(), std::strerror(errno)));
+    }
+    std::fprintf(file, "%s%s\n", identity_prefix, render_identity.c_str());
+    std::fprintf(file, "# frame, size and CRC-32 of every written image\n");
+    for (const auto& frame : intact_frames)
+    {
+        if (frame.first >= output_counter)
+            break;
+        std::fprintf(
+                file,
+                "%llu %llu %lu\n",
+                (unsigned long long) frame.first,
+                (unsigned long long) frame.second.size,
+                (unsigned long) frame.second.checksum);
+    }
+    if (std::fflush(file) != 0 || std::rename(new_path.c_str(), path.c_str()) != 0)
+    {
+        std::fclose(file);
+        throw std::runtime_error(Utils::str_format(
+                "Cannot write %s: %s", path.c_str(), std::strerror(errno)));
+    }
+    manifest = file;
+}
+
+void ImageSequenceSink::record(std::uint64_t frame, const std::vector<unsigned char>& image)
+{
+    const std::uint32_t image_checksum = checksum(image.data(), image.size());
+    std::lock_guard<std::mutex> lock(manifest_mutex);
+    // the line is complete once flushed, so it survives the process being killed. Neither it
+    // nor the image are synced to the disk, so after a power loss either may be lost or torn;
+    // resuming checks every listed image against its size and checksum, which catches both.
+    std::fprintf(
+            manifest,
+            "%llu %llu %lu\n",
+            (unsigned long long) frame,
+            (unsigned long long) image.size(),
+            (unsigned long) image_checksum);
+    std::fflush(manifest);
+}
+
+void ImageSequenceSink::set_render_settings(const RenderSettings& settings)
+{
+    render_identity = Utils::str_format(
+            "%dx%d quality %d fps %.17g %s compression %d filter %d",
+            settings.width,
+            settings.height,
+            (int) settings.quality,
+            settings.fps,
+            extension().c_str(),
+            png_options.compression_level,
+            (int) png_options.filter);
+    if (!intact_frames.empty() && render_identity != resumed_identity)
+    {
+        Logger::info(Utils::str_format(
+                "Images in %s/ were rendered with other settings, all frames are rendered again.",
+                directory.c_str()));
+    }
+}
+
+std::uint64_t ImageSequenceSink::completed_frames()
+{
+    // without knowing the settings of this render, no image can be trusted
+    if (render_identity.empty() || render_identity != resumed_identity)
+        return 0;
+
+    std::uint64_t count = 0;
+    while (intact_frames.count(count))
+    {
+        ++count;
+    }
+    return count;
+}
+
+void ImageSequenceSink::skip_frames(std::uint64_t count)
+{
+    if (count > completed_frames())
+    {
+        throw std::logic_error(Utils::str_format(
+                "Only %llu frames can be skipped.", (unsigned long long) completed_frames()));
+    }
+    output_counter = count;
+}
+
+void ImageSequenceSink::write(const Scene::Snapshot& frame)
+{
+    if (!manifest)
+    {
+        prepare_directory();
+        open_manifest();
+    }
+
+    const std::uint64_t frame_number = output_counter++;
+    const std::string filename = image_path(frame_number);
+
+    const ImageFormat format = this->format;
+    const PngOptions png_options = this->png_options;
+    const bool direct_io = this->direct_io;
+    auto save = [=]()
+    {
+        // reused by all frames encoded by the same thread
+        thread_local std::vector<unsigned char> buffer;
+        frame.encode(format, png_options, buffer);
+        write_file(filename, buffer.data(), buffer.size(), direct_io);
+        record(frame_number, buffer);
+    };
+
+    if (writer)
+        writer->submit(save);
+    else
+        save();
+}
+
+void ImageSequenceSink::finish()
+{
+    if (writer)
+        writer->wait();
+
+    const std::string output = Utils::with_extension(output_file, ".mp4");
+    if (std::system(NULL) == 0)
+        throw std::runtime_error("Cannot start FFmpeg, no shell is available.");
+
+    std::ostringstream ss;
+    ss << "ffmpeg -r "
+       << std::to_string(fps)
+       << " -f image2 -i "
+       << directory
+       << "/%d" << extension() << " -vcodec libx264 -crf 25 -pix_fmt yuv420p "
+       << output;
+    Logger::info(ss.str());
+    const int status = std::system(ss.str().c_str());
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "FFmpeg failed to encode %s.", output.c_str()));
+    }
+}
+
+} // namespace Sian
@@ -0,0 +1,396 @@
+#include "config.hh"
+#include "png.hh"
+
+#include <cairo.h>
+#include <zlib.h>
+
+#include <algorithm> // std::min
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstdlib> // std::abs
+#include <cstring> // std::memcpy
+#include <stdexcept>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIAN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace Sian {
+
+namespace {
+
+// size of the buffer for compressed data, and so the largest IDAT chunk
+const std::size_t chunk_capacity = 1 << 17;
+
+// Vector kernels write up to this many bytes past the end of a converted row.
+const std::size_t row_padding = 32;
+
+// Converts native-endian cairo pixels of a row, starting at column x, to bytes of a PNG row:
+// R, G, B (and A) with straight alpha. Rounds the same way as cairo's own PNG writer.
+void convert_row_scalar(
+        const std::uint32_t* pixels,
+        int x,
+        int width,
+        bool has_alpha,
+        unsigned char* out)
+{
+    for (; x < width; ++x)
+    {
+        const std::uint32_t pixel = pixels[x];
+        unsigned a = pixel >> 24;
+        unsigned r = (pixel >> 16) & 0xff;
+        unsigned g = (pixel >> 8) & 0xff;
+        unsigned b = pixel & 0xff;
+        if (!has_alpha)
+        {
+            out[3 * x] = r;
+            out[3 * x + 1] = g;
+            out[3 * x + 2] = b;
+            continue;
+        }
+
+        if (a == 0)
+        {
+            r = g = b = 0;
+        }
+        else if (a != 0xff)
+        {
+            r = std::min((r * 255 + a / 2) / a, 255u);
+            g = std::min((g * 255 + a / 2) / a, 255u);
+            b = std::min((b * 255 + a / 2) / a, 255u);
+        }
+        out[4 * x] = r;
+        out[4 * x + 1] = g;
+        out[4 * x + 2] = b;
+        out[4 * x + 3] = a;
+    }
+}
+
+// Vector kernels convert as many pixels as vectors fit into the row and return the column
+// where they stopped.
+using RowKernel = int (*)(const std::uint32_t* pixels, int width, bool has_alpha, unsigned char* out);
+
+int convert_row_none(const std::uint32_t* pixels, int width, bool has_alpha, unsigned char* out)
+{
+    return 0;
+}
+
+#ifdef SIAN_X86_SIMD
+
+// Pixels are stored as native-endian 32-bit words, so their bytes are in order B, G, R, A.
+// Opaque pixels only need their bytes reordered. Otherwise, channels are divided by alpha in
+// single precision, which is exact for quotients of integers of this size.
+
+__attribute__((target("sse4.1")))
+int convert_row_sse41(const std::uint32_t* pixels, int width, bool has_alpha, unsigned char* out)
+{
+    const __m128i rgba_order = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m128i rgb_order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m128i byte_mask = _mm_set1_epi32(0xff);
+    const __m128i opaque = _mm_set1_epi32(0xff);
+    const __m128i one = _mm_set1_epi32(1);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i pixel = _mm_loadu_si128((const __m128i*) (pixels + x));
+        if (!has_alpha)
+        {
+            // the last four bytes are overwritten by the next pixels or are padding
+            _mm_storeu_si128((__m128i*) (out + 3 * x), _mm_shuffle_epi8(pixel, rgb_order));
+            continue;
+        }
+
+        __m128i rgba = _mm_shuffle_epi8(pixel, rgba_order);
+        const __m128i alpha = _mm_srli_epi32(pixel, 24);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, opaque)) != 0xffff)
+        {
+            const __m128 divisor = _mm_cvtepi32_ps(_mm_max_epi32(alpha, one));
+            const __m128i half = _mm_srli_epi32(alpha, 1);
+            __m128i channels = alpha;
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                __m128i c = _mm_and_si128(_mm_srli_epi32(rgba, shift), byte_mask);
+                c = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(c, 8), c), half);
+                c = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(c), divisor));
+                c = _mm_min_epi32(c, opaque);
+                channels = _mm_or_si128(channels, _mm_slli_epi32(c, shift + 8));
+            }
+            // channels hold A, R, G, B from the lowest byte, rotate them to R, G, B, A
+            rgba = _mm_or_si128(_mm_srli_epi32(channels, 8), _mm_slli_epi32(alpha, 24));
+            // fully transparent pixels have no color
+            rgba = _mm_andnot_si128(_mm_cmpeq_epi32(alpha, _mm_setzero_si128()), rgba);
+        }
+        _mm_storeu_si128((__m128i*) (out + 4 * x), rgba);
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+int convert_row_avx2(const std::uint32_t* pixels, int width, bool has_alpha, unsigned char* out)
+{
+    const __m256i rgba_order = _mm256_setr_epi8(
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m256i rgb_order = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i byte_mask = _mm256_set1_epi32(0xff);
+    const __m256i opaque = _mm256_set1_epi32(0xff);
+    const __m256i one = _mm256_set1_epi32(1);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i pixel = _mm256_loadu_si256((const __m256i*) (pixels + x));
+        if (!has_alpha)
+        {
+            // shuffles don't cross the 128-bit lanes, so each lane is stored separately
+            const __m256i rgb = _mm256_shuffle_epi8(pixel, rgb_order);
+            _mm_storeu_si128((__m128i*) (out + 3 * x), _mm256_castsi256_si128(rgb));
+            _mm_storeu_si128((__m128i*) (out + 3 * x + 12), _mm256_extracti128_si256(rgb, 1));
+            continue;
+        }
+
+        __m256i rgba = _mm256_shuffle_epi8(pixel, rgba_order);
+        const __m256i alpha = _mm256_srli_epi32(pixel, 24);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, opaque)) != -1)
+        {
+            const __m256 divisor = _mm256_cvtepi32_ps(_mm256_max_epi32(alpha, one));
+            const __m256i half = _mm256_srli_epi32(alpha, 1);
+            __m256i channels = alpha;
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                __m256i c = _mm256_and_si256(_mm256_srli_epi32(rgba, shift), byte_mask);
+                c = _mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(c, 8), c), half);
+                c = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(c), divisor));
+                c = _mm256_min_epi32(c, opaque);
+                channels = _mm256_or_si256(channels, _mm256_slli_epi32(c, shift + 8));
+            }
+            rgba = _mm256_or_si256(_mm256_srli_epi32(channels, 8), _mm256_slli_epi32(alpha, 24));
+            rgba = _mm256_andnot_si256(_mm256_cmpeq_epi32(alpha, _mm256_setzero_si256()), rgba);
+        }
+        _mm256_storeu_si256((__m256i*) (out + 4 * x), rgba);
+    }
+    return x;
+}
+
+#endif
+
+RowKernel select_kernel()
+{
+#ifdef SIAN_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return convert_row_avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return convert_row_sse41;
+#endif
+    return convert_row_none;
+}
+
+unsigned char paeth_predictor(int left, int up, int up_left)
+{
+    const int estimate = left + up - up_left;
+    const int to_left = std::abs(estimate - left);
+    const int to_up = std::abs(estimate - up);
+    const int to_up_left = std::abs(estimate - up_left);
+    if (to_left <= to_up && to_left <= to_up_left)
+        return left;
+    if (to_up <= to_up_left)
+        return up;
+    return up_left;
+}
+
+// Writes the filter type followed by the filtered row into out.
+void filter_row(
+        PngFilter filter,
+        const unsigned char* row,
+        const unsigned char* previous,
+        std::size_t size,
+        std::size_t bpp,
+        unsigned char* out)
+{
+    // the values of PngFilter up to PAETH are the filter types of PNG
+    out[0] = (unsigned char) filter;
+    unsigned char* filtered = out + 1;
+    switch (filter)
+    {
+    case PngFilter::NONE:
+        std::memcpy(filtered, row, size);
+        break;
+    case PngFilter::SUB:
+        std::memcpy(filtered, row, bpp);
+        for (std::size_t i = bpp; i < size; ++i)
+            filtered[i] = row[i] - row[i - bpp];
+        break;
+    case PngFilter::UP:
+        for (std::size_t i = 0; i < size; ++i)
+            filtered[i] = row[i] - previous[i];
+        break;
+    case PngFilter::AVERAGE:
+        for (std::size_t i = 0; i < bpp; ++i)
+            filtered[i] = row[i] - previous[i] / 2;
+        for (std::size_t i = bpp; i < size; ++i)
+            filtered[i] = row[i] - (row[i - bpp] + previous[i]) / 2;
+        break;
+    case PngFilter::PAETH:
+        for (std::size_t i = 0; i < bpp; ++i)
+            filtered[i] = row[i] - previous[i];
+        for (std::size_t i = bpp; i < size; ++i)
+            filtered[i] = row[i] - paeth_predictor(row[i - bpp], previous[i], previous[i - bpp]);
+        break;
+    case PngFilter::ADAPTIVE:
+        throw std::logic_error("The adaptive filter is not a filter of its own.");
+    }
+}
+
+// Estimates how well a filtered row compresses, preferring values close to zero.
+std::size_t filtered_cost(const unsigned char* filtered, std::size_t size)
+{
+    std::size_t cost = 0;
+    for (std::size_t i = 0; i < size; ++i)
+        cost += std::abs((int) (signed char) filtered[i]);
+    return cost;
+}
+
+void store_u32(unsigned char* out, std::uint32_t value)
+{
+    out[0] = value >> 24;
+    out[1] = (value >> 16) & 0xff;
+    out[2] = (value >> 8) & 0xff;
+    out[3] = value & 0xff;
+}
+
+void append(std::vector<unsigned char>& out, const void* data, std::size_t size)
+{
+    out.insert(out.end(), (const unsigned char*) data, (const unsigned char*) data + size);
+}
+
+void append_chunk(
+        std::vector<unsigned char>& out,
+        const char* type,
+        const unsigned char* data,
+        std::size_t size)
+{
+    unsigned char length[4];
+    store_u32(length, size);
+    append(out, length, 4);
+    append(out, type, 4);
+    append(out, data, size);
+
+    uLong crc = crc32(0, (const Bytef*) type, 4);
+    // zlib would restart the checksum when given no data
+    if (size > 0)
+        crc = crc32(crc, data, size);
+    unsigned char checksum[4];
+    store_u32(checksum, crc);
+    append(out, checksum, 4);
+}
+
+} // namespace Sian::{anonymous}
+
+void encode_png(
+        const unsigned char* data,
+        int stride,
+        int width,
+        int height,
+        cairo_format_t format,
+        const PngOptions& options,
+        std::vector<unsigned char>& out)
+{
+    const bool has_alpha = format == CAIRO_FORMAT_ARGB32;
+    const std::size_t bpp = has_alpha ? 4 : 3;
+    const std::size_t row_size = bpp * width;
+
+    out.clear();
+    const unsigned char signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+    append(out, signature, sizeof(signature));
+
+    unsigned char header[13];
+    store_u32(header, width);
+    store_u32(header + 4, height);
+    header[8] = 8; // bit depth
+    header[9] = has_alpha ? 6 : 2; // color type: RGBA or RGB
+    header[10] = 0; // compression
+    header[11] = 0; // filter method
+    header[12] = 0; // no interlacing
+    append_chunk(out, "IHDR", header, sizeof(header));
+
+    z_stream stream = {};
+    const int strategy = options.filter == PngFilter::NONE ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+    if (deflateInit2(&stream, options.compression_level, Z_DEFLATED, 15, 8, strategy) != Z_OK)
+        throw std::runtime_error("Cannot initialize zlib.");
+
+    // the row above the first one is taken as zeros
+    std::vector<unsigned char> rows[2] = {
+        std::vector<unsigned char>(row_size + row_padding, 0),
+        std::vector<unsigned char>(row_size + row_padding, 0)
+    };
+    const int filter_count = options.filter == PngFilter::ADAPTIVE ? 5 : 1;
+    std::vector<unsigned char> filtered(filter_count * (row_size + 1));
+    std::vector<unsigned char> compressed(chunk_capacity);
+    stream.next_out = compressed.data();
+    stream.avail_out = compressed.size();
+
+    static const RowKernel kernel = select_kernel();
+    for (int y = 0; y <= height; ++y)
+    {
+        const unsigned char* input = nullptr;
+        std::size_t input_size = 0;
+        if (y < height)
+        {
+            unsigned char* row = rows[y % 2].data();
+            const unsigned char* previous = rows[(y + 1) % 2].data();
+            const std::uint32_t* pixels = (const std::uint32_t*) (data + (std::size_t) y * stride);
+            convert_row_scalar(pixels, kernel(pixels, width, has_alpha, row), width, has_alpha, row);
+
+            input = filtered.data();
+            input_size = row_size + 1;
+            if (options.filter != PngFilter::ADAPTIVE)
+            {
+                filter_row(options.filter, row, previous, row_size, bpp, filtered.data());
+            }
+            else
+            {
+                std::size_t best_cost = SIZE_MAX;
+                for (int filter = 0; filter < filter_count; ++filter)
+                {
+                    unsigned char* out = filtered.data() + filter * (row_size + 1);
+                    filter_row((PngFilter) filter, row, previous, row_size, bpp, out);
+                    const std::size_t cost = filtered_cost(out + 1, row_size);
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        input = out;
+                    }
+                }
+            }
+        }
+
+        // the last pass only flushes the rest of the compressed data
+        stream.next_in = (Bytef*) input;
+        stream.avail_in = input_size;
+        const int flush = y < height ? Z_NO_FLUSH : Z_FINISH;
+        int status = Z_OK;
+        do
+        {
+            status = deflate(&stream, flush);
+            if (stream.avail_out == 0 || status == Z_STREAM_END)
+            {
+                const std::size_t size = compressed.size() - stream.avail_out;
+                append_chunk(out, "IDAT", compressed.data(), size);
+                stream.next_out = compressed.data();
+                stream.avail_out = compressed.size();
+            }
+        }
+        while (stream.avail_in > 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+    }
+    deflateEnd(&stream);
+
+    append_chunk(out, "IEND", nullptr, 0);
+}
+
+} // namespace Sian
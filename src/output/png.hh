@@ -0,0 +1,25 @@
+#ifndef PNG_HH
+#define PNG_HH
+
+#include "config.hh"
+
+#include <cairo.h>
+
+#include <vector>
+
+namespace Sian {
+
+// Encodes pixels of a cairo image surface as a PNG image into out, replacing its content.
+// ARGB32 pixels are unpremultiplied and stored with alpha, RGB24 ones without it.
+void encode_png(
+        const unsigned char* data,
+        int stride,
+        int width,
+        int height,
+        cairo_format_t format,
+        const PngOptions& options,
+        std::vector<unsigned char>& out);
+
+} // namespace Sian
+
+#endif
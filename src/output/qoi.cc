@@ -0,0 +1,189 @@
+#include "qoi.hh"
+
+#include <cairo.h>
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstring> // std::memcpy
+
+namespace Sian {
+
+namespace {
+
+const unsigned char op_index = 0x00;
+const unsigned char op_diff = 0x40;
+const unsigned char op_luma = 0x80;
+const unsigned char op_run = 0xc0;
+const unsigned char op_rgb = 0xfe;
+const unsigned char op_rgba = 0xff;
+
+const int header_size = 14;
+const unsigned char end_marker[] = {0, 0, 0, 0, 0, 0, 0, 1};
+// longest run a single op_run can encode
+const int max_run = 62;
+
+struct Rgba
+{
+    unsigned char r, g, b, a;
+
+    bool operator==(const Rgba& other) const
+    {
+        return r == other.r && g == other.g && b == other.b && a == other.a;
+    }
+
+    int hash() const
+    {
+        return (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+    }
+};
+
+// Converts a native-endian cairo pixel to straight (not premultiplied) alpha.
+Rgba unpremultiply(std::uint32_t pixel)
+{
+    const unsigned a = pixel >> 24;
+    unsigned r = (pixel >> 16) & 0xff;
+    unsigned g = (pixel >> 8) & 0xff;
+    unsigned b = pixel & 0xff;
+    if (a == 0)
+        return {0, 0, 0, 0};
+    if (a != 0xff)
+    {
+        r = (r * 255 + a / 2) / a;
+        g = (g * 255 + a / 2) / a;
+        b = (b * 255 + a / 2) / a;
+    }
+    return {(unsigned char) r, (unsigned char) g, (unsigned char) b, (unsigned char) a};
+}
+
+unsigned char* write_u32(unsigned char* out, std::uint32_t value)
+{
+    *out++ = value >> 24;
+    *out++ = (value >> 16) & 0xff;
+    *out++ = (value >> 8) & 0xff;
+    *out++ = value & 0xff;
+    return out;
+}
+
+} // namespace Sian::{anonymous}
+
+std::size_t qoi_max_size(int width, int height)
+{
+    // every pixel takes at most a tag and four channels
+    return header_size + (std::size_t) width * height * 5 + sizeof(end_marker);
+}
+
+std::size_t encode_qoi(
+        const unsigned char* data,
+        int stride,
+        int width,
+        int height,
+        cairo_format_t format,
+        unsigned char* out)
+{
+    const bool has_alpha = format == CAIRO_FORMAT_ARGB32;
+    // the unused byte of RGB24 pixels is undefined, so it's treated as opaque alpha
+    const std::uint32_t alpha_mask = has_alpha ? 0 : 0xff000000u;
+
+    unsigned char* position = out;
+    std::memcpy(position, "qoif", 4);
+    position = write_u32(position + 4, width);
+    position = write_u32(position, height);
+    *position++ = has_alpha ? 4 : 3;
+    // sRGB with linear alpha
+    *position++ = 0;
+
+    Rgba index[64] = {};
+    Rgba previous = {0, 0, 0, 255};
+    // the previous pixel as stored by cairo, sparing conversion of repeated pixels
+    std::uint32_t previous_pixel = 0xff000000u;
+    int run = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        const std::uint32_t* row = (const std::uint32_t*) (data + (std::size_t) y * stride);
+        for (int x = 0; x < width; ++x)
+        {
+            const std::uint32_t pixel = row[x] | alpha_mask;
+            if (pixel == previous_pixel)
+            {
+                if (++run == max_run)
+                {
+                    *position++ = op_run | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            previous_pixel = pixel;
+
+            const Rgba current = unpremultiply(pixel);
+            // different premultiplied pixels can still give the same color
+            if (current == previous)
+            {
+                if (++run == max_run)
+                {
+                    *position++ = op_run | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0)
+            {
+                *position++ = op_run | (run - 1);
+                run = 0;
+            }
+
+            const int hash = current.hash();
+            if (index[hash] == current)
+            {
+                *position++ = op_index | hash;
+            }
+            else
+            {
+                index[hash] = current;
+                if (current.a == previous.a)
+                {
+                    const signed char dr = current.r - previous.r;
+                    const signed char dg = current.g - previous.g;
+                    const signed char db = current.b - previous.b;
+                    const signed char dr_dg = dr - dg;
+                    const signed char db_dg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        *position++ = op_diff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+                    }
+                    else if (dg >= -32 && dg <= 31 &&
+                             dr_dg >= -8 && dr_dg <= 7 &&
+                             db_dg >= -8 && db_dg <= 7)
+                    {
+                        *position++ = op_luma | (dg + 32);
+                        *position++ = (dr_dg + 8) << 4 | (db_dg + 8);
+                    }
+                    else
+                    {
+                        *position++ = op_rgb;
+                        *position++ = current.r;
+                        *position++ = current.g;
+                        *position++ = current.b;
+                    }
+                }
+                else
+                {
+                    *position++ = op_rgba;
+                    *position++ = current.r;
+                    *position++ = current.g;
+                    *position++ = current.b;
+                    *position++ = current.a;
+                }
+            }
+            previous = current;
+        }
+    }
+    if (run > 0)
+        *position++ = op_run | (run - 1);
+
+    std::memcpy(position, end_marker, sizeof(end_marker));
+    position += sizeof(end_marker);
+    return position - out;
+}
+
+} // namespace Sian
@@ -0,0 +1,26 @@
+#ifndef QOI_HH
+#define QOI_HH
+
+#include <cairo.h>
+
+#include <cstddef> // std::size_t
+
+namespace Sian {
+
+// Number of bytes an image of the given dimensions can take at most when encoded as QOI.
+std::size_t qoi_max_size(int width, int height);
+
+// Encodes pixels of a cairo image surface as a QOI image (https://qoiformat.org) into out,
+// which has to hold qoi_max_size() bytes. ARGB32 pixels are unpremultiplied and stored with
+// alpha, RGB24 ones without it. Returns the size of the image.
+std::size_t encode_qoi(
+        const unsigned char* data,
+        int stride,
+        int width,
+        int height,
+        cairo_format_t format,
+        unsigned char* out);
+
+} // namespace Sian
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef SHARED_MEMORY_RING_HH
+#define SHARED_MEMORY_RING_HH
+
+#include <atomic>
+#include <cstddef> // std::size_t
+#include <cstdint>
+
+namespace Sian {
+namespace SharedMemoryRing {
+
+// Layout of the shared memory, common to SharedMemoryRingSink and SharedMemoryRingReader.
+// The memory starts with Header, followed by slot_count slots. Each slot starts with
+// SlotHeader, followed by height rows of stride bytes of pixels.
+
+const std::uint32_t magic = 0x5349414E;
+const std::uint32_t version = 1;
+
+// every part of the memory starts at a new cache line
+const std::size_t alignment = 64;
+
+struct Header
+{
+    // written last by the producer, once the rest of the header is filled in
+    std::atomic<std::uint32_t> magic;
+    std::uint32_t version;
+    std::uint32_t slot_count;
+    // value of RingOverflow
+    std::uint32_t overflow;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t stride;
+    // value of cairo_format_t
+    std::int32_t format;
+    std::uint64_t slot_size;
+    std::uint64_t slots_offset;
+    std::uint64_t pixels_offset;
+
+    // number of frames published by the producer
+    alignas(alignment) std::atomic<std::uint64_t> write_index;
+    // number of frames consumed by the consumer
+    alignas(alignment) std::atomic<std::uint64_t> read_index;
+    // set by the producer once there will be no more frames
+    std::atomic<std::uint32_t> finished;
+};
+
+// Slots are guarded by a sequence lock, so that the consumer can recognize frames
+// that have been overwritten while it was reading them.
+struct SlotHeader
+{
+    // 2n + 1 while the frame n is being written, 2n + 2 once it is complete
+    std::atomic<std::uint64_t> sequence;
+    std::uint64_t presentation_time_ns;
+    // time of std::chrono::steady_clock, which is shared by processes on the same host
+    std::uint64_t publish_time_ns;
+};
+
+static_assert(
+        std::atomic<std::uint64_t>::is_always_lock_free &&
+        std::atomic<std::uint32_t>::is_always_lock_free,
+        "atomics in shared memory have to be lock-free");
+
+inline std::size_t aligned(std::size_t size)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+inline SlotHeader* slot(void* memory, std::uint64_t frame)
+{
+    const Header* header = (const Header*) memory;
+    return (SlotHeader*) ((unsigned char*) memory +
+                          header->slots_offset +
+                          (frame % header->slot_count) * header->slot_size);
+}
+
+inline unsigned char* slot_pixels(void* memory, std::uint64_t frame)
+{
+    const Header* header = (const Header*) memory;
+    return (unsigned char*) slot(memory, frame) + header->pixels_offset;
+}
+
+} // namespace Sian::SharedMemoryRing
+} // namespace Sian
+
+#endif
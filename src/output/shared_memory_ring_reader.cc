@@ -0,0 +1,156 @@
+#include "shared_memory_ring.hh"
+#include "shared_memory_ring_reader.hh"
+#include "shared_memory_ring_sink.hh"
+#include "utils.hh"
+
+#include <cairo.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring> // std::memcpy, std::strerror
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Sian {
+
+using namespace SharedMemoryRing;
+
+SharedMemoryRingReader::SharedMemoryRingReader(const std::string& name)
+{
+    fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Cannot open shared memory %s: %s", name.c_str(), std::strerror(errno)));
+    }
+
+    // the header tells how large the whole ring is
+    void* header_memory = mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+    if (header_memory == MAP_FAILED)
+    {
+        ::close(fd);
+        throw std::runtime_error(Utils::str_format(
+                "Cannot map shared memory %s: %s", name.c_str(), std::strerror(errno)));
+    }
+    const Header* header = (const Header*) header_memory;
+    const bool ready = header->magic.load(std::memory_order_acquire) == SharedMemoryRing::magic;
+    const bool compatible = header->version == version;
+    size = header->slots_offset + header->slot_size * header->slot_count;
+    munmap(header_memory, sizeof(Header));
+    if (!ready || !compatible)
+    {
+        ::close(fd);
+        throw std::runtime_error(Utils::str_format(
+                ready ? "Shared memory %s has an incompatible layout." :
+                        "Shared memory %s hasn't been initialized yet.",
+                name.c_str()));
+    }
+
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        memory = nullptr;
+        ::close(fd);
+        throw std::runtime_error(Utils::str_format(
+                "Cannot map shared memory %s: %s", name.c_str(), std::strerror(errno)));
+    }
+}
+
+SharedMemoryRingReader::~SharedMemoryRingReader()
+{
+    if (memory)
+        munmap(memory, size);
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool SharedMemoryRingReader::read(std::vector<unsigned char>& pixels, FrameInfo& info)
+{
+    Header* header = (Header*) memory;
+    const std::size_t frame_size = (std::size_t) header->stride * header->height;
+    while (true)
+    {
+        const std::uint64_t written = header->write_index.load(std::memory_order_acquire);
+        if (next_frame == written)
+            return false;
+        if (written - next_frame > header->slot_count)
+        {
+            // the producer has overwritten some frames
+            dropped += written - header->slot_count - next_frame;
+            next_frame = written - header->slot_count;
+        }
+
+        const SlotHeader* slot_header = slot(memory, next_frame);
+        const std::uint64_t sequence = slot_header->sequence.load(std::memory_order_acquire);
+        if (sequence == 2 * next_frame + 2)
+        {
+            pixels.resize(frame_size);
+            std::memcpy(pixels.data(), slot_pixels(memory, next_frame), frame_size);
+            fill_info(next_frame, info);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot_header->sequence.load(std::memory_order_relaxed) == sequence)
+            {
+                ++next_frame;
+                header->read_index.store(next_frame, std::memory_order_release);
+                return true;
+            }
+        }
+        // the frame was overwritten before (or while) it was copied
+        ++dropped;
+        ++next_frame;
+    }
+}
+
+const unsigned char* SharedMemoryRingReader::acquire(FrameInfo& info)
+{
+    Header* header = (Header*) memory;
+    if (header->overflow != (std::uint32_t) RingOverflow::BLOCK)
+        throw std::logic_error("Frames can only be acquired when the producer blocks on overflow.");
+
+    if (next_frame == header->write_index.load(std::memory_order_acquire))
+        return nullptr;
+    fill_info(next_frame, info);
+    acquired = true;
+    return slot_pixels(memory, next_frame);
+}
+
+void SharedMemoryRingReader::release()
+{
+    if (!acquired)
+        return;
+    acquired = false;
+    ++next_frame;
+    ((Header*) memory)->read_index.store(next_frame, std::memory_order_release);
+}
+
+bool SharedMemoryRingReader::finished() const
+{
+    const Header* header = (const Header*) memory;
+    return header->finished.load(std::memory_order_acquire) &&
+           next_frame == header->write_index.load(std::memory_order_acquire);
+}
+
+std::uint64_t SharedMemoryRingReader::dropped_frames() const
+{
+    return dropped;
+}
+
+void SharedMemoryRingReader::fill_info(std::uint64_t frame, FrameInfo& info) const
+{
+    const Header* header = (const Header*) memory;
+    const SlotHeader* slot_header = slot(memory, frame);
+    info.frame = frame;
+    info.presentation_time_ns = slot_header->presentation_time_ns;
+    info.publish_time_ns = slot_header->publish_time_ns;
+    info.width = header->width;
+    info.height = header->height;
+    info.stride = header->stride;
+    info.format = (cairo_format_t) header->format;
+}
+
+} // namespace Sian
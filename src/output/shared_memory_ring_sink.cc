@@ -0,0 +1,182 @@
+#include "scene.hh"
+#include "shared_memory_ring.hh"
+#include "shared_memory_ring_sink.hh"
+#include "utils.hh"
+
+#include <cairo.h>
+
+#include <algorithm> // std::min
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring> // std::memcpy, std::strerror
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Sian {
+
+using namespace SharedMemoryRing;
+
+SharedMemoryRingSink::SharedMemoryRingSink(
+        const std::string& name,
+        double fps,
+        int slot_count,
+        RingOverflow overflow)
+    : name(name),
+      fps(fps),
+      slot_count(slot_count),
+      overflow(overflow)
+{
+    if (slot_count < 2)
+        throw std::invalid_argument("The ring needs at least two slots.");
+}
+
+SharedMemoryRingSink::~SharedMemoryRingSink()
+{
+    close();
+}
+
+void SharedMemoryRingSink::open(int width, int height, cairo_format_t format)
+{
+    const int stride = cairo_format_stride_for_width(format, width);
+    const std::size_t pixels_offset = aligned(sizeof(SlotHeader));
+    const std::size_t slot_size = pixels_offset + aligned((std::size_t) stride * height);
+    const std::size_t slots_offset = aligned(sizeof(Header));
+    size = slots_offset + slot_size * slot_count;
+
+    // a ring left behind by a crashed producer is replaced
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, size) != 0)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Cannot create shared memory %s: %s", name.c_str(), std::strerror(errno)));
+    }
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        memory = nullptr;
+        throw std::runtime_error(Utils::str_format(
+                "Cannot map shared memory %s: %s", name.c_str(), std::strerror(errno)));
+    }
+
+    Header* header = new (memory) Header();
+    header->version = version;
+    header->slot_count = slot_count;
+    header->overflow = (std::uint32_t) overflow;
+    header->width = width;
+    header->height = height;
+    header->stride = stride;
+    header->format = format;
+    header->slot_size = slot_size;
+    header->slots_offset = slots_offset;
+    header->pixels_offset = pixels_offset;
+    for (int i = 0; i < slot_count; ++i)
+    {
+        new (slot(memory, i)) SlotHeader();
+    }
+    header->magic.store(SharedMemoryRing::magic, std::memory_order_release);
+}
+
+void SharedMemoryRingSink::close()
+{
+    if (memory)
+    {
+        ((Header*) memory)->finished.store(1, std::memory_order_release);
+        munmap(memory, size);
+        memory = nullptr;
+    }
+    if (fd >= 0)
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        fd = -1;
+    }
+}
+
+unsigned char* SharedMemoryRingSink::frame_buffer(
+        int width,
+        int height,
+        cairo_format_t format,
+        int& stride)
+{
+    if (!memory)
+        open(width, height, format);
+
+    const Header* header = (const Header*) memory;
+    if (width != header->width || height != header->height || format != header->format)
+    {
+        throw std::logic_error(Utils::str_format(
+                "All frames published to %s must have the same dimensions and format.",
+                name.c_str()));
+    }
+
+    stride = header->stride;
+    return begin_frame();
+}
+
+unsigned char* SharedMemoryRingSink::begin_frame()
+{
+    if (frame_begun)
+        return slot_pixels(memory, next_frame);
+
+    Header* header = (Header*) memory;
+    if (overflow == RingOverflow::BLOCK)
+    {
+        while (next_frame - header->read_index.load(std::memory_order_acquire) >=
+               (std::uint64_t) slot_count)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    // the consumer recognizes the odd sequence number as a frame being written
+    slot(memory, next_frame)->sequence.store(2 * next_frame + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    frame_begun = true;
+    return slot_pixels(memory, next_frame);
+}
+
+void SharedMemoryRingSink::write(const Scene::Snapshot& frame)
+{
+    const Scene::Snapshot::Pixels pixels = frame.pixels();
+    int stride = 0;
+    unsigned char* target = frame_buffer(pixels.width, pixels.height, pixels.format, stride);
+
+    // frames that haven't been drawn directly into the slot are copied
+    if (pixels.data != target)
+    {
+        const std::size_t row_size = std::min(stride, pixels.stride);
+        for (int y = 0; y < pixels.height; ++y)
+        {
+            std::memcpy(
+                    target + (std::size_t) y * stride,
+                    pixels.data + (std::size_t) y * pixels.stride,
+                    row_size);
+        }
+    }
+
+    SlotHeader* slot_header = slot(memory, next_frame);
+    slot_header->presentation_time_ns = (std::uint64_t) (next_frame * 1e9 / fps);
+    slot_header->publish_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    slot_header->sequence.store(2 * next_frame + 2, std::memory_order_release);
+
+    ++next_frame;
+    ((Header*) memory)->write_index.store(next_frame, std::memory_order_release);
+    frame_begun = false;
+}
+
+void SharedMemoryRingSink::finish()
+{
+    if (memory)
+        ((Header*) memory)->finished.store(1, std::memory_order_release);
+}
+
+} // namespace Sian
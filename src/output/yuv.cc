@@ -0,0 +1,355 @@
+#include "yuv.hh"
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstring> // std::memcpy
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIAN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace Sian {
+
+namespace {
+
+struct Planes
+{
+    const unsigned char* argb;
+    int stride;
+    int width;
+    int height;
+    ChromaLayout layout;
+    unsigned char* y;
+    // for NV12, u is the interleaved plane and v is unused
+    unsigned char* u;
+    unsigned char* v;
+};
+
+int chroma_width(int width)
+{
+    return (width + 1) / 2;
+}
+
+int chroma_height(int height)
+{
+    return (height + 1) / 2;
+}
+
+unsigned char luma(int r, int g, int b)
+{
+    return (unsigned char) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+// r, g and b are sums over a 2x2 block of pixels
+unsigned char chroma_u(int r, int g, int b)
+{
+    return (unsigned char) (((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+}
+
+unsigned char chroma_v(int r, int g, int b)
+{
+    return (unsigned char) (((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+}
+
+// Converts a pair of rows starting at (even) column x. At the right and bottom edges
+// of frames with odd dimensions, the missing pixels of a block are replaced by their neighbours.
+void convert_rows_scalar(const Planes& p, int row, int x)
+{
+    const int rows = row + 1 < p.height ? 2 : 1;
+    const std::size_t chroma_row = (std::size_t) (row / 2) * chroma_width(p.width);
+
+    for (; x < p.width; x += 2)
+    {
+        const int columns = x + 1 < p.width ? 2 : 1;
+        int r_sum = 0, g_sum = 0, b_sum = 0;
+        for (int k = 0; k < 2; ++k)
+        {
+            const int pixel_row = row + (k < rows ? k : 0);
+            const std::uint32_t* pixels =
+                (const std::uint32_t*) (p.argb + (std::size_t) pixel_row * p.stride);
+            for (int j = 0; j < 2; ++j)
+            {
+                const std::uint32_t pixel = pixels[x + (j < columns ? j : 0)];
+                const int r = (pixel >> 16) & 0xFF;
+                const int g = (pixel >> 8) & 0xFF;
+                const int b = pixel & 0xFF;
+                r_sum += r;
+                g_sum += g;
+                b_sum += b;
+                if (k < rows && j < columns)
+                    p.y[(std::size_t) pixel_row * p.width + x + j] = luma(r, g, b);
+            }
+        }
+
+        const std::size_t i = chroma_row + x / 2;
+        if (p.layout == ChromaLayout::I420)
+        {
+            p.u[i] = chroma_u(r_sum, g_sum, b_sum);
+            p.v[i] = chroma_v(r_sum, g_sum, b_sum);
+        }
+        else
+        {
+            p.u[2 * i] = chroma_u(r_sum, g_sum, b_sum);
+            p.u[2 * i + 1] = chroma_v(r_sum, g_sum, b_sum);
+        }
+    }
+}
+
+// Vectorized kernels convert a pair of rows from the first column for as long as whole
+// vectors fit into the row, and return the column where they stopped.
+using RowsKernel = int (*)(const Planes& p, int row);
+
+int convert_rows_none(const Planes& p, int row)
+{
+    return 0;
+}
+
+#ifdef SIAN_X86_SIMD
+
+// Pixels are stored as native-endian 32-bit words, so their bytes are in order B, G, R, A.
+
+__attribute__((target("sse4.1")))
+int convert_rows_sse41(const Planes& p, int row)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i luma_coefficients = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+    const __m128i u_coefficients = _mm_setr_epi16(112, -74, -38, 0, 112, -74, -38, 0);
+    const __m128i v_coefficients = _mm_setr_epi16(-18, -94, 112, 0, -18, -94, 112, 0);
+    const __m128i luma_rounding = _mm_set1_epi32(128);
+    const __m128i luma_offset = _mm_set1_epi32(16);
+    const __m128i chroma_rounding = _mm_set1_epi32(512);
+    const __m128i chroma_offset = _mm_set1_epi32(128);
+
+    const unsigned char* rows[2] = {
+        p.argb + (std::size_t) row * p.stride,
+        p.argb + (std::size_t) (row + 1) * p.stride
+    };
+    unsigned char* luma_rows[2] = {
+        p.y + (std::size_t) row * p.width,
+        p.y + (std::size_t) (row + 1) * p.width
+    };
+    const std::size_t chroma_row = (std::size_t) (row / 2) * chroma_width(p.width);
+
+    // eight pixels of both rows at a time
+    int x = 0;
+    for (; x + 8 <= p.width; x += 8)
+    {
+        __m128i luma_sums[2][2];
+        __m128i blocks[2];
+        for (int half = 0; half < 2; ++half)
+        {
+            __m128i low_sum = zero;
+            __m128i high_sum = zero;
+            for (int k = 0; k < 2; ++k)
+            {
+                const __m128i pixels = _mm_loadu_si128(
+                        (const __m128i*) (rows[k] + 4 * (x + 4 * half)));
+                const __m128i low = _mm_cvtepu8_epi16(pixels);
+                const __m128i high = _mm_cvtepu8_epi16(_mm_srli_si128(pixels, 8));
+                luma_sums[k][half] = _mm_hadd_epi32(
+                        _mm_madd_epi16(low, luma_coefficients),
+                        _mm_madd_epi16(high, luma_coefficients));
+                low_sum = _mm_add_epi16(low_sum, low);
+                high_sum = _mm_add_epi16(high_sum, high);
+            }
+            // sums of horizontally neighbouring pixels complete the 2x2 blocks
+            low_sum = _mm_add_epi16(low_sum, _mm_srli_si128(low_sum, 8));
+            high_sum = _mm_add_epi16(high_sum, _mm_srli_si128(high_sum, 8));
+            blocks[half] = _mm_unpacklo_epi64(low_sum, high_sum);
+        }
+
+        for (int k = 0; k < 2; ++k)
+        {
+            __m128i y[2];
+            for (int half = 0; half < 2; ++half)
+            {
+                y[half] = _mm_add_epi32(
+                        _mm_srai_epi32(_mm_add_epi32(luma_sums[k][half], luma_rounding), 8),
+                        luma_offset);
+            }
+            const __m128i y16 = _mm_packs_epi32(y[0], y[1]);
+            _mm_storel_epi64((__m128i*) (luma_rows[k] + x), _mm_packus_epi16(y16, y16));
+        }
+
+        __m128i u = _mm_hadd_epi32(
+                _mm_madd_epi16(blocks[0], u_coefficients),
+                _mm_madd_epi16(blocks[1], u_coefficients));
+        __m128i v = _mm_hadd_epi32(
+                _mm_madd_epi16(blocks[0], v_coefficients),
+                _mm_madd_epi16(blocks[1], v_coefficients));
+        u = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(u, chroma_rounding), 10), chroma_offset);
+        v = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(v, chroma_rounding), 10), chroma_offset);
+        // bytes u0 u1 u2 u3 v0 v1 v2 v3
+        const __m128i uv = _mm_packus_epi16(_mm_packs_epi32(u, v), zero);
+
+        const std::size_t i = chroma_row + x / 2;
+        if (p.layout == ChromaLayout::I420)
+        {
+            const std::int32_t u_samples = _mm_cvtsi128_si32(uv);
+            const std::int32_t v_samples = _mm_cvtsi128_si32(_mm_srli_si128(uv, 4));
+            std::memcpy(p.u + i, &u_samples, 4);
+            std::memcpy(p.v + i, &v_samples, 4);
+        }
+        else
+        {
+            _mm_storel_epi64(
+                    (__m128i*) (p.u + 2 * i),
+                    _mm_unpacklo_epi8(uv, _mm_srli_si128(uv, 4)));
+        }
+    }
+    return x;
+}
+
+// The same as the SSE4.1 kernel, with the two 128-bit lanes processing different pixels.
+__attribute__((target("avx2")))
+int convert_rows_avx2(const Planes& p, int row)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i luma_coefficients = _mm256_setr_epi16(
+            25, 129, 66, 0, 25, 129, 66, 0, 25, 129, 66, 0, 25, 129, 66, 0);
+    const __m256i u_coefficients = _mm256_setr_epi16(
+            112, -74, -38, 0, 112, -74, -38, 0, 112, -74, -38, 0, 112, -74, -38, 0);
+    const __m256i v_coefficients = _mm256_setr_epi16(
+            -18, -94, 112, 0, -18, -94, 112, 0, -18, -94, 112, 0, -18, -94, 112, 0);
+    const __m256i luma_rounding = _mm256_set1_epi32(128);
+    const __m256i luma_offset = _mm256_set1_epi32(16);
+    const __m256i chroma_rounding = _mm256_set1_epi32(512);
+    const __m256i chroma_offset = _mm256_set1_epi32(128);
+    const __m256i luma_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    const unsigned char* rows[2] = {
+        p.argb + (std::size_t) row * p.stride,
+        p.argb + (std::size_t) (row + 1) * p.stride
+    };
+    unsigned char* luma_rows[2] = {
+        p.y + (std::size_t) row * p.width,
+        p.y + (std::size_t) (row + 1) * p.width
+    };
+    const std::size_t chroma_row = (std::size_t) (row / 2) * chroma_width(p.width);
+
+    // sixteen pixels of both rows at a time
+    int x = 0;
+    for (; x + 16 <= p.width; x += 16)
+    {
+        // lanes of luma_sums hold pixels 0-3 and 4-7 of the half,
+        // lanes of blocks hold blocks 0-1 and 2-3 of the half
+        __m256i luma_sums[2][2];
+        __m256i blocks[2];
+        for (int half = 0; half < 2; ++half)
+        {
+            __m256i low_sum = zero;
+            __m256i high_sum = zero;
+            for (int k = 0; k < 2; ++k)
+            {
+                const __m256i pixels = _mm256_loadu_si256(
+                        (const __m256i*) (rows[k] + 4 * (x + 8 * half)));
+                const __m256i low = _mm256_unpacklo_epi8(pixels, zero);
+                const __m256i high = _mm256_unpackhi_epi8(pixels, zero);
+                luma_sums[k][half] = _mm256_hadd_epi32(
+                        _mm256_madd_epi16(low, luma_coefficients),
+                        _mm256_madd_epi16(high, luma_coefficients));
+                low_sum = _mm256_add_epi16(low_sum, low);
+                high_sum = _mm256_add_epi16(high_sum, high);
+            }
+            low_sum = _mm256_add_epi16(low_sum, _mm256_srli_si256(low_sum, 8));
+            high_sum = _mm256_add_epi16(high_sum, _mm256_srli_si256(high_sum, 8));
+            blocks[half] = _mm256_unpacklo_epi64(low_sum, high_sum);
+        }
+
+        for (int k = 0; k < 2; ++k)
+        {
+            __m256i y[2];
+            for (int half = 0; half < 2; ++half)
+            {
+                y[half] = _mm256_add_epi32(
+                        _mm256_srai_epi32(_mm256_add_epi32(luma_sums[k][half], luma_rounding), 8),
+                        luma_offset);
+            }
+            const __m256i y16 = _mm256_packs_epi32(y[0], y[1]);
+            const __m256i y8 = _mm256_permutevar8x32_epi32(
+                    _mm256_packus_epi16(y16, y16),
+                    luma_order);
+            _mm_storeu_si128((__m128i*) (luma_rows[k] + x), _mm256_castsi256_si128(y8));
+        }
+
+        __m256i u = _mm256_hadd_epi32(
+                _mm256_madd_epi16(blocks[0], u_coefficients),
+                _mm256_madd_epi16(blocks[1], u_coefficients));
+        __m256i v = _mm256_hadd_epi32(
+                _mm256_madd_epi16(blocks[0], v_coefficients),
+                _mm256_madd_epi16(blocks[1], v_coefficients));
+        u = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(u, chroma_rounding), 10), chroma_offset);
+        v = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(v, chroma_rounding), 10), chroma_offset);
+        // lanes hold bytes u0 u1 u4 u5 v0 v1 v4 v5 and u2 u3 u6 u7 v2 v3 v6 v7
+        const __m256i uv8 = _mm256_packus_epi16(_mm256_packs_epi32(u, v), zero);
+        // bytes u0 ... u7 v0 ... v7
+        const __m128i uv = _mm_unpacklo_epi16(
+                _mm256_castsi256_si128(uv8),
+                _mm256_extracti128_si256(uv8, 1));
+
+        const std::size_t i = chroma_row + x / 2;
+        if (p.layout == ChromaLayout::I420)
+        {
+            _mm_storel_epi64((__m128i*) (p.u + i), uv);
+            _mm_storel_epi64((__m128i*) (p.v + i), _mm_srli_si128(uv, 8));
+        }
+        else
+        {
+            _mm_storeu_si128(
+                    (__m128i*) (p.u + 2 * i),
+                    _mm_unpacklo_epi8(uv, _mm_srli_si128(uv, 8)));
+        }
+    }
+    return x;
+}
+
+#endif
+
+RowsKernel select_kernel()
+{
+#ifdef SIAN_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return convert_rows_avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return convert_rows_sse41;
+#endif
+    return convert_rows_none;
+}
+
+} // namespace Sian::{anonymous}
+
+std::size_t yuv420_size(int width, int height)
+{
+    return (std::size_t) width * height +
+           2 * (std::size_t) chroma_width(width) * chroma_height(height);
+}
+
+void argb_to_yuv420(
+        const unsigned char* argb,
+        int stride,
+        int width,
+        int height,
+        ChromaLayout layout,
+        unsigned char* out)
+{
+    const std::size_t luma_size = (std::size_t) width * height;
+    const std::size_t chroma_size = (std::size_t) chroma_width(width) * chroma_height(height);
+    const Planes planes = {
+        argb, stride, width, height, layout,
+        out,
+        out + luma_size,
+        layout == ChromaLayout::I420 ? out + luma_size + chroma_size : nullptr
+    };
+
+    static const RowsKernel kernel = select_kernel();
+    for (int row = 0; row < height; row += 2)
+    {
+        // the last row of frames with odd height has no pair
+        const int x = row + 1 < height ? kernel(planes, row) : 0;
+        convert_rows_scalar(planes, row, x);
+    }
+}
+
+} // namespace Sian
@@ -1,27 +1,329 @@
+#include "layer.hh"
+#include "output/file_writer.hh"
 #include "object.hh"
+#include "output/png.hh"
+#include "output/qoi.hh"
 #include "scene.hh"
+#include "shape.hh"
+#include "spatial_grid.hh"
+#include "animated_value.hh"
+#include "utils.hh"
+#include "worker_pool.hh"
 
 #include <cairo.h>
 
+#include <algorithm> // std::max, std::min
+#include <atomic>
+#include <cmath> // std::ceil
+#include <cstddef> // std::size_t
 #include <initializer_list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <stdexcept> // std::invalid_argument
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility> // std::move, std::pair
+#include <vector>
 
 namespace Sian {
 
+namespace {
+
+// size of a cell of the spatial index in pixels
+const double index_cell_size = 64.0;
+
+Box wrapper_box(Object& object)
+{
+    const Offset offset = object.offset.get();
+    const double bleed = object.bleed();
+    return {
+        offset.x - bleed,
+        offset.y - bleed,
+        offset.x + object.x_dimension() + bleed,
+        offset.y + object.y_dimension() + bleed
+    };
+}
+
+// Part of the drawing order. Either a single object, or shapes that are stroked at once.
+struct DrawGroup
+{
+    Object* object;
+    std::vector<Shape*> shapes;
+    StrokeStyle style;
+    Box bounds;
+};
+
+// how many groups back a shape may be moved in order to join a group of the same style
+const std::size_t batch_lookback = 32;
+
+// Shapes can be moved earlier in the drawing order as long as they don't overlap
+// with anything they'd be moved in front of.
+std::vector<DrawGroup> group_by_style(const std::vector<Object*>& objects)
+{
+    std::vector<DrawGroup> groups;
+    for (Object* object : objects)
+    {
+        const Box box = wrapper_box(*object);
+        Shape* shape = dynamic_cast<Shape*>(object);
+        if (!shape || !shape->batchable() || shape->sprite_caching())
+        {
+            groups.push_back({object, {}, {}, box});
+            continue;
+        }
+
+        const StrokeStyle style = shape->stroke_style();
+        // a single stroke of overlapping translucent shapes differs from separate strokes
+        const bool opaque = style.alpha >= 1;
+        const std::size_t first = groups.size() > batch_lookback ? groups.size() - batch_lookback : 0;
+        bool joined = false;
+        for (std::size_t k = groups.size(); k-- > first; )
+        {
+            DrawGroup& group = groups[k];
+            const bool overlaps = group.bounds.intersects(box);
+            if (!group.shapes.empty() && group.style == style && (opaque || !overlaps))
+            {
+                group.shapes.push_back(shape);
+                group.bounds = {
+                    std::min(group.bounds.left, box.left),
+                    std::min(group.bounds.top, box.top),
+                    std::max(group.bounds.right, box.right),
+                    std::max(group.bounds.bottom, box.bottom)
+                };
+                joined = true;
+                break;
+            }
+            if (overlaps)
+                break;
+        }
+        if (!joined)
+            groups.push_back({nullptr, {shape}, style, box});
+    }
+    return groups;
+}
+
+std::vector<DrawGroup> make_groups(const std::vector<Object*>& visible, bool batch)
+{
+    if (batch)
+        return group_by_style(visible);
+
+    std::vector<DrawGroup> groups;
+    for (Object* object : visible)
+    {
+        groups.push_back({object, {}, {}, wrapper_box(*object)});
+    }
+    return groups;
+}
+
+// Draws the background and the groups in coordinates of the scene. If region is given,
+// only groups intersecting it are drawn.
+void draw_groups(
+        cairo_t* cr, Layer* background, const std::vector<DrawGroup>& groups, const Box* region)
+{
+    cairo_set_line_width(cr, 2.0);
+
+    if (background && background->is_visible())
+        background->render(cr);
+
+    // default color
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+
+    for (const DrawGroup& group : groups)
+    {
+        if (region && !group.bounds.intersects(*region))
+            continue;
+        if (group.object)
+            group.object->render(cr);
+        else
+            Shape::draw_batch(cr, group.shapes);
+    }
+}
+
+// Draws a horizontal stripe of the canvas directly into the memory of the whole frame.
+// The stripe is given in pixels of the frame. Only groups intersecting the stripe
+// are drawn, unless culling is disabled.
+void draw_stripe(
+        unsigned char* data, int stride, int width, int y_from, int y_to,
+        const QualityProfile& profile, double scale_x, double scale_y,
+        Layer* background, const std::vector<DrawGroup>& groups, bool cull)
+{
+    cairo_surface_t* stripe = cairo_image_surface_create_for_data(
+            data + (std::size_t) y_from * stride,
+            profile.format,
+            width,
+            y_to - y_from,
+            stride);
+    cairo_t* cr = cairo_create(stripe);
+    cairo_set_antialias(cr, profile.antialias);
+    cairo_set_tolerance(cr, profile.tolerance);
+
+    // background
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_paint(cr);
+
+    cairo_translate(cr, 0.0, -y_from);
+    cairo_scale(cr, scale_x, scale_y);
+    const Box region = {0.0, y_from / scale_y, width / scale_x, y_to / scale_y};
+    draw_groups(cr, background, groups, cull ? &region : nullptr);
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(stripe);
+}
+
+// every thread draws several stripes, so that threads with light stripes can help the others
+const int stripes_per_thread = 4;
+
+// events planned for a time that has been reached up to a rounding error are processed as well
+const double time_epsilon = 1e-9;
+
+void update_minimum(std::atomic<std::size_t>& value, std::size_t candidate)
+{
+    std::size_t current = value.load(std::memory_order_relaxed);
+    while (candidate < current && !value.compare_exchange_weak(current, candidate))
+    { }
+}
+
+} // namespace Sian::{anonymous}
+
+struct Scene::Checkpoint
+{
+    double time;
+    std::vector<std::shared_ptr<Object>> objects;
+    std::shared_ptr<Layer> background;
+    std::multimap<double, Event> events;
+    // the values are owned by the objects above, which the checkpoint keeps alive
+    std::vector<std::pair<UpdatableValue*, std::unique_ptr<ValueState>>> values;
+
+    void save_values(Object& object)
+    {
+        for (UpdatableValue* value : object.tracked_values())
+        {
+            values.emplace_back(value, value->save_state());
+        }
+    }
+};
+
+class Scene::SlotObserver : public ValueObserver
+{
+public:
+    SlotObserver(const Scene& scene, std::size_t slot)
+        : scene(scene),
+          slot(slot)
+    { }
+
+    virtual void value_changed() override
+    {
+        // the slot is listed once until the index takes it
+        if (!marked.exchange(true))
+            scene.mark_changed(slot);
+    }
+
+    const Scene& scene;
+    const std::size_t slot;
+    std::atomic<bool> marked{false};
+};
+
 Scene::Scene(const Config& config)
     : config(config),
-      next_step_id(0)
+      next_step_id(0),
+      time(0)
+{
+    reset_index();
+}
+
+Scene::~Scene()
 { }
 
 void Scene::add(std::shared_ptr<Object> object)
 {
+    partition_valid = false;
+    slots.emplace(object.get(), objects.size());
     objects.push_back(object);
+    sleeping.push_back(false);
+    sleep_revisions.push_back(0);
+    observe_slot(objects.size() - 1);
 }
 
 void Scene::add(std::initializer_list<std::shared_ptr<Object>> new_objects)
 {
-    objects.insert(objects.end(), new_objects.begin(), new_objects.end());
+    for (const auto& object : new_objects)
+    {
+        add(object);
+    }
+}
+
+void Scene::remove(std::shared_ptr<Object> object)
+{
+    const auto range = slots.equal_range(object.get());
+    if (range.first == range.second)
+        return;
+    // an object added more than once leaves its first slot
+    auto slot = range.first;
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second < slot->second)
+            slot = it;
+    }
+    const std::size_t i = slot->second;
+    slots.erase(slot);
+
+    // the partition and the spatial index stay valid, they just skip the empty slot
+    objects[i] = nullptr;
+    slot_observers[i] = nullptr;
+    sleeping[i] = false;
+    index->remove(i);
+    if (++removed_count * 2 > objects.size())
+        compact();
+}
+
+void Scene::compact()
+{
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        if (!objects[i])
+            continue;
+        objects[kept] = std::move(objects[i]);
+        sleeping[kept] = sleeping[i];
+        sleep_revisions[kept] = sleep_revisions[i];
+        ++kept;
+    }
+    objects.resize(kept);
+    sleeping.resize(kept);
+    sleep_revisions.resize(kept);
+    removed_count = 0;
+
+    slots.clear();
+    slot_observers.clear();
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        slots.emplace(objects[i].get(), i);
+        observe_slot(i);
+    }
+    partition_valid = false;
+    reset_index();
+}
+
+void Scene::add_at(double time, std::shared_ptr<Object> object)
+{
+    if (time <= this->time + time_epsilon)
+        add(object);
+    else
+        events.insert({time, {EventType::ADD, object}});
+}
+
+void Scene::remove_at(double time, std::shared_ptr<Object> object)
+{
+    if (time <= this->time + time_epsilon)
+        remove(object);
+    else
+        events.insert({time, {EventType::REMOVE, object}});
+}
+
+double Scene::current_time() const
+{
+    return time;
 }
 
 void Scene::add_show_creation(std::shared_ptr<Object> object)
@@ -30,47 +332,608 @@ void Scene::add_show_creation(std::shared_ptr<Object> object)
     add(object);
 }
 
+void Scene::set_background(std::shared_ptr<Object> new_background)
+{
+    background = std::make_shared<Layer>(new_background);
+}
+
 Scene::Snapshot Scene::snapshot() const
 {
+    return snapshot(config.main_scene_width, config.main_scene_height, config.quality);
+}
+
+Scene::Snapshot Scene::snapshot(int output_width, int output_height, Quality quality) const
+{
+    layout();
+    const QualityProfile profile = QualityProfile::of(quality);
+    return Snapshot(draw_frame(output_width, output_height, profile, nullptr));
+}
+
+Scene::Snapshot Scene::snapshot_into(
+        unsigned char* data,
+        int stride,
+        int width,
+        int height,
+        Quality quality) const
+{
+    layout();
+    return draw_into(data, stride, width, height, QualityProfile::of(quality), nullptr);
+}
+
+Scene::Snapshot Scene::draw_into(
+        unsigned char* data,
+        int stride,
+        int width,
+        int height,
+        const QualityProfile& profile,
+        cairo_surface_t* recording) const
+{
+    if (stride < cairo_format_stride_for_width(profile.format, width) || stride % 4 != 0)
+    {
+        throw std::invalid_argument(Utils::str_format(
+                "Stride %d is not suitable for frames %d pixels wide.", stride, width));
+    }
+
     std::shared_ptr<cairo_surface_t> surface(
-            cairo_image_surface_create(
-                CAIRO_FORMAT_ARGB32,
-                config.main_scene_width,
-                config.main_scene_height),
+            cairo_image_surface_create_for_data(data, profile.format, width, height, stride),
             cairo_surface_destroy);
-    cairo_t* cr = cairo_create(surface.get());
+    draw_frame(surface.get(), profile, recording);
+    return Snapshot(surface);
+}
+
+std::shared_ptr<cairo_surface_t> Scene::record() const
+{
+    layout();
+    const cairo_rectangle_t extents = {
+        0.0, 0.0, (double) config.main_scene_width, (double) config.main_scene_height
+    };
+    std::shared_ptr<cairo_surface_t> recording(
+            cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, &extents),
+            cairo_surface_destroy);
+    cairo_t* cr = cairo_create(recording.get());
     cairo_set_antialias(cr, CAIRO_ANTIALIAS_BEST);
-    cairo_set_line_width(cr, 2.0);
 
-    // background
     cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
-    cairo_rectangle(cr, 0.0, 0.0, config.main_scene_width, config.main_scene_height);
-    cairo_fill(cr);
+    cairo_paint(cr);
+    draw_groups(
+            cr,
+            background.get(),
+            make_groups(visible_on_canvas(), config.batch_strokes),
+            nullptr);
 
-    // default color
-    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    cairo_destroy(cr);
+    return recording;
+}
 
-    for (const auto& object : objects)
+Scene::Snapshot Scene::replay(
+        std::shared_ptr<cairo_surface_t> recording,
+        int output_width,
+        int output_height,
+        Quality quality) const
+{
+    const QualityProfile profile = QualityProfile::of(quality);
+    return Snapshot(draw_frame(output_width, output_height, profile, recording.get()));
+}
+
+Scene::Snapshot Scene::replay_into(
+        std::shared_ptr<cairo_surface_t> recording,
+        unsigned char* data,
+        int stride,
+        int width,
+        int height,
+        Quality quality) const
+{
+    return draw_into(data, stride, width, height, QualityProfile::of(quality), recording.get());
+}
+
+std::shared_ptr<cairo_surface_t> Scene::draw_frame(
+        int output_width,
+        int output_height,
+        const QualityProfile& profile,
+        cairo_surface_t* recording) const
+{
+    std::shared_ptr<cairo_surface_t> surface(
+            cairo_image_surface_create(
+                profile.format,
+                profile.frame_dimension(output_width),
+                profile.frame_dimension(output_height)),
+            cairo_surface_destroy);
+    draw_frame(surface.get(), profile, recording);
+    return surface;
+}
+
+void Scene::draw_frame(
+        cairo_surface_t* target,
+        const QualityProfile& profile,
+        cairo_surface_t* recording) const
+{
+    if (!profile.upscale || profile.render_scale == 1.0)
     {
-        object->draw(cr);
+        draw_at_resolution(target, profile, recording);
+        return;
     }
 
+    const int width = cairo_image_surface_get_width(target);
+    const int height = cairo_image_surface_get_height(target);
+    std::shared_ptr<cairo_surface_t> frame(
+            cairo_image_surface_create(
+                profile.format,
+                (int) std::ceil(width * profile.render_scale),
+                (int) std::ceil(height * profile.render_scale)),
+            cairo_surface_destroy);
+    draw_at_resolution(frame.get(), profile, recording);
+
+    cairo_t* cr = cairo_create(target);
+    cairo_scale(
+            cr,
+            (double) width / cairo_image_surface_get_width(frame.get()),
+            (double) height / cairo_image_surface_get_height(frame.get()));
+    cairo_set_source_surface(cr, frame.get(), 0.0, 0.0);
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BILINEAR);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
     cairo_destroy(cr);
-    return Snapshot(surface);
 }
 
-void Scene::step(double time_delta)
+void Scene::draw_at_resolution(
+        cairo_surface_t* target,
+        const QualityProfile& profile,
+        cairo_surface_t* recording) const
+{
+    const int width = cairo_image_surface_get_width(target);
+    const int height = cairo_image_surface_get_height(target);
+    const double scale_x = (double) width / config.main_scene_width;
+    const double scale_y = (double) height / config.main_scene_height;
+
+    if (recording)
+    {
+        cairo_t* cr = cairo_create(target);
+        cairo_set_antialias(cr, profile.antialias);
+        cairo_set_tolerance(cr, profile.tolerance);
+        cairo_scale(cr, scale_x, scale_y);
+        cairo_set_source_surface(cr, recording, 0.0, 0.0);
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+        return;
+    }
+
+    const std::vector<DrawGroup> groups = make_groups(visible_on_canvas(), config.batch_strokes);
+
+    // all stripes are drawn into the same buffer, so no intermediate surfaces are needed
+    cairo_surface_flush(target);
+    unsigned char* data = cairo_image_surface_get_data(target);
+    const int stride = cairo_image_surface_get_stride(target);
+
+    const int threads = render_thread_count();
+    if (threads == 1)
+    {
+        draw_stripe(
+                data, stride, width, 0, height,
+                profile, scale_x, scale_y, background.get(), groups, false);
+    }
+    else
+    {
+        const int stripe_count = std::min(height, threads * stripes_per_thread);
+        const int stripe_height = (height + stripe_count - 1) / stripe_count;
+        worker_pool().run(threads, stripe_count, [&] (std::size_t s)
+        {
+            const int y_from = s * stripe_height;
+            if (y_from >= height)
+                return;
+            const int y_to = std::min(height, y_from + stripe_height);
+            draw_stripe(
+                    data, stride, width, y_from, y_to,
+                    profile, scale_x, scale_y, background.get(), groups,
+                    config.cull_offscreen);
+        });
+    }
+    cairo_surface_mark_dirty(target);
+}
+
+WorkerPool& Scene::worker_pool() const
+{
+    if (!workers)
+        workers = std::make_unique<WorkerPool>(std::max(step_thread_count(), render_thread_count()));
+    return *workers;
+}
+
+int Scene::render_thread_count() const
+{
+    if (config.render_threads > 0)
+        return config.render_threads;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void Scene::layout() const
 {
     for (const auto& object_ptr : objects)
     {
-        object_ptr->step(time_delta, next_step_id);
+        if (object_ptr)
+            object_ptr->layout();
     }
+    if (background)
+        background->layout();
+}
+
+void Scene::update_index() const
+{
+    // only objects that might have moved are reinserted
+    updated_slots.clear();
+    {
+        std::lock_guard<std::mutex> lock(changed_mutex);
+        updated_slots.swap(changed_slots);
+    }
+    for (std::size_t i : updated_slots)
+    {
+        if (!objects[i])
+            continue;
+        // changes made from now on list the slot again
+        slot_observers[i]->marked = false;
+        index->update(i, wrapper_box(*objects[i]));
+    }
+}
+
+void Scene::reset_index() const
+{
+    index = std::make_unique<SpatialGrid>(
+            Box{0.0, 0.0, (double) config.main_scene_width, (double) config.main_scene_height},
+            index_cell_size);
+
+    std::lock_guard<std::mutex> lock(changed_mutex);
+    changed_slots.clear();
+    for (std::size_t i = 0; i < slot_observers.size(); ++i)
+    {
+        if (!slot_observers[i])
+            continue;
+        slot_observers[i]->marked = true;
+        changed_slots.push_back(i);
+    }
+}
+
+void Scene::observe_slot(std::size_t i)
+{
+    if (slot_observers.size() <= i)
+        slot_observers.resize(i + 1);
+    slot_observers[i] = std::make_shared<SlotObserver>(*this, i);
+    slot_observers[i]->marked = true;
+    {
+        std::lock_guard<std::mutex> lock(changed_mutex);
+        changed_slots.push_back(i);
+    }
+    objects[i]->observe(slot_observers[i]);
+}
+
+void Scene::mark_changed(std::size_t i) const
+{
+    std::lock_guard<std::mutex> lock(changed_mutex);
+    changed_slots.push_back(i);
+}
+
+std::vector<Object*> Scene::visible_on_canvas() const
+{
+    std::vector<Object*> visible;
+    for (std::size_t i : objects_on_canvas())
+    {
+        if (objects[i]->is_visible())
+            visible.push_back(objects[i].get());
+    }
+    return visible;
+}
+
+const std::vector<std::size_t>& Scene::objects_on_canvas() const
+{
+    visible_objects.clear();
+    if (!config.cull_offscreen)
+    {
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            if (objects[i])
+                visible_objects.push_back(i);
+        }
+        return visible_objects;
+    }
+
+    update_index();
+    const Box canvas = {0.0, 0.0, (double) config.main_scene_width, (double) config.main_scene_height};
+    index->query(canvas, visible_objects);
+    return visible_objects;
+}
+
+void Scene::step(double time_delta)
+{
+    const int threads = step_thread_count();
+    std::size_t stepped = 0;
+    if (threads > 1 && objects.size() > 1)
+        stepped = step_in_parallel(time_delta, threads);
+
+    for (std::size_t i = stepped; i < objects.size(); ++i)
+    {
+        step_object(i, time_delta);
+    }
+    if (background)
+        background->step(time_delta, next_step_id);
     ++next_step_id;
+    time += time_delta;
+
+    process_events();
+    update_sleeping();
+}
+
+std::shared_ptr<const Scene::Checkpoint> Scene::checkpoint()
+{
+    auto checkpoint = std::make_shared<Checkpoint>();
+    checkpoint->time = time;
+    checkpoint->background = background;
+    checkpoint->events = events;
+
+    for (const auto& object : objects)
+    {
+        if (!object)
+            continue;
+        checkpoint->objects.push_back(object);
+        checkpoint->save_values(*object);
+    }
+    if (background)
+        checkpoint->save_values(*background);
+    // objects to be added later may be animated already
+    for (const auto& event : events)
+    {
+        checkpoint->save_values(*event.second.object);
+    }
+    return checkpoint;
+}
+
+void Scene::restore(const Checkpoint& checkpoint)
+{
+    time = checkpoint.time;
+    objects = checkpoint.objects;
+    background = checkpoint.background;
+    events = checkpoint.events;
+    for (const auto& value : checkpoint.values)
+    {
+        value.first->restore_state(*value.second);
+    }
+
+    // step IDs keep increasing, so that values don't skip the following steps
+    sleeping.assign(objects.size(), false);
+    sleep_revisions.assign(objects.size(), 0);
+    removed_count = 0;
+    slots.clear();
+    slot_observers.clear();
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        slots.emplace(objects[i].get(), i);
+        observe_slot(i);
+    }
+    partition_valid = false;
+    reset_index();
+}
+
+void Scene::step_object(std::size_t i, double time_delta)
+{
+    if (!objects[i])
+        return;
+    if (sleeping[i])
+    {
+        if (objects[i]->revision() == sleep_revisions[i])
+            return;
+        // something has changed the object from outside
+        sleeping[i] = false;
+    }
+    objects[i]->step(time_delta, next_step_id);
+}
+
+std::size_t Scene::step_in_parallel(double time_delta, int threads)
+{
+    if (!partition_valid)
+        partition();
+
+    // objects are checked in parallel as well, without changing anything
+    const std::size_t count = objects.size();
+    std::vector<unsigned char> awake(count, 0);
+    std::atomic<std::size_t> first_finishing(count);
+    std::atomic<bool> connections_changed(false);
+    worker_pool().run(threads, components.size(), [&] (std::size_t c)
+    {
+        for (std::size_t i : components[c])
+        {
+            if (!objects[i])
+                continue;
+            const std::vector<UpdatableValue*>& values = objects[i]->tracked_values();
+            std::size_t state = partitioned_offsets[i];
+            bool same = values.size() == partitioned_offsets[i + 1] - state;
+            bool finishing = false;
+            for (UpdatableValue* value : values)
+            {
+                same = same && value->shared_state() == partitioned_states[state++];
+                finishing = finishing || value->may_finish(time_delta);
+            }
+            if (!same)
+                connections_changed = true;
+
+            awake[i] = !sleeping[i] || objects[i]->revision() != sleep_revisions[i];
+            if (awake[i] && finishing)
+                update_minimum(first_finishing, i);
+        }
+    });
+
+    // values have been connected since the objects were partitioned
+    if (connections_changed)
+    {
+        partition_valid = false;
+        return 0;
+    }
+
+    // components are in drawing order, so the leading objects of each can be stepped
+    const std::size_t stepped = first_finishing;
+    worker_pool().run(threads, components.size(), [&] (std::size_t c)
+    {
+        for (std::size_t i : components[c])
+        {
+            if (i >= stepped)
+                break;
+            if (awake[i])
+                objects[i]->step(time_delta, next_step_id);
+        }
+    });
+    for (std::size_t i = 0; i < stepped; ++i)
+    {
+        if (awake[i])
+            sleeping[i] = false;
+    }
+    return stepped;
+}
+
+void Scene::partition()
+{
+    const std::size_t count = objects.size();
+    std::vector<std::size_t> parent(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        parent[i] = i;
+    }
+    const auto root = [&parent] (std::size_t i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+
+    // objects sharing a state with an earlier object join its component
+    std::unordered_map<const void*, std::size_t> owners;
+    partitioned_states.clear();
+    partitioned_offsets.assign(1, 0);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (!objects[i])
+        {
+            partitioned_offsets.push_back(partitioned_states.size());
+            continue;
+        }
+        for (UpdatableValue* value : objects[i]->tracked_values())
+        {
+            const void* state = value->shared_state();
+            partitioned_states.push_back(state);
+            const auto owner = owners.emplace(state, i);
+            if (!owner.second)
+                parent[root(i)] = root(owner.first->second);
+        }
+        partitioned_offsets.push_back(partitioned_states.size());
+    }
+
+    components.clear();
+    std::vector<std::size_t> component_of_root(count, count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::size_t& component = component_of_root[root(i)];
+        if (component == count)
+        {
+            component = components.size();
+            components.emplace_back();
+        }
+        components[component].push_back(i);
+    }
+    partition_valid = true;
+}
+
+int Scene::step_thread_count() const
+{
+    if (config.step_threads > 0)
+        return config.step_threads;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void Scene::process_events()
+{
+    while (!events.empty() && events.begin()->first <= time + time_epsilon)
+    {
+        const Event event = events.begin()->second;
+        events.erase(events.begin());
+        if (event.type == EventType::ADD)
+            add(event.object);
+        else
+            remove(event.object);
+    }
+}
+
+void Scene::update_sleeping()
+{
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        if (!objects[i] || sleeping[i] || objects[i]->is_visible() || !objects[i]->is_settled())
+            continue;
+        sleeping[i] = true;
+        sleep_revisions[i] = objects[i]->revision();
+    }
 }
 
 void Scene::Snapshot::save_png(std::string filename) const
 {
-    cairo_surface_write_to_png(surface.get(), filename.c_str());
+    save_png(filename, PngOptions());
+}
+
+void Scene::Snapshot::save_png(std::string filename, const PngOptions& options) const
+{
+    // reused by all snapshots saved by the same thread
+    thread_local std::vector<unsigned char> buffer;
+    encode(ImageFormat::PNG, options, buffer);
+    write_file(filename, buffer.data(), buffer.size());
+}
+
+void Scene::Snapshot::save_qoi(std::string filename) const
+{
+    thread_local std::vector<unsigned char> buffer;
+    encode(ImageFormat::QOI, PngOptions(), buffer);
+    write_file(filename, buffer.data(), buffer.size());
+}
+
+void Scene::Snapshot::encode(
+        ImageFormat format,
+        const PngOptions& options,
+        std::vector<unsigned char>& out) const
+{
+    const Pixels frame = pixels();
+    if (frame.format != CAIRO_FORMAT_ARGB32 && frame.format != CAIRO_FORMAT_RGB24)
+        throw std::invalid_argument("Only snapshots with 32 bits per pixel can be encoded.");
+
+    if (format == ImageFormat::PNG)
+    {
+        encode_png(
+                frame.data,
+                frame.stride,
+                frame.width,
+                frame.height,
+                frame.format,
+                options,
+                out);
+        return;
+    }
+
+    out.resize(qoi_max_size(frame.width, frame.height));
+    const std::size_t size = encode_qoi(
+            frame.data,
+            frame.stride,
+            frame.width,
+            frame.height,
+            frame.format,
+            out.data());
+    out.resize(size);
+}
+
+Scene::Snapshot::Pixels Scene::Snapshot::pixels() const
+{
+    cairo_surface_flush(surface.get());
+    return {
+        cairo_image_surface_get_data(surface.get()),
+        cairo_image_surface_get_stride(surface.get()),
+        cairo_image_surface_get_format(surface.get()),
+        cairo_image_surface_get_width(surface.get()),
+        cairo_image_surface_get_height(surface.get())
+    };
 }
 
 Scene::Snapshot::Snapshot(std::shared_ptr<cairo_surface_t> surface)
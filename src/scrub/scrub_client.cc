@@ -0,0 +1,90 @@
+#include "scrub_client.hh"
+#include "scrub/scrub_protocol.hh"
+#include "utils.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring> // std::strerror, std::strncpy
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Sian {
+
+using namespace ScrubProtocol;
+
+ScrubClient::ScrubClient(const std::string& socket_path)
+    : socket_path(socket_path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+    {
+        throw std::invalid_argument(Utils::str_format(
+                "Socket path %s is too long.", socket_path.c_str()));
+    }
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (const sockaddr*) &address, sizeof(address)) != 0)
+    {
+        const int error = errno;
+        if (fd >= 0)
+            ::close(fd);
+        throw std::runtime_error(Utils::str_format(
+                "Cannot connect to %s: %s", socket_path.c_str(), std::strerror(error)));
+    }
+}
+
+ScrubClient::~ScrubClient()
+{
+    ::close(fd);
+}
+
+void ScrubClient::send_request(std::uint32_t type, ScrubFormat format, double time)
+{
+    const Request request = {magic, version, type, (std::uint32_t) format, time};
+    if (!send_all(fd, &request, sizeof(request)))
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Server at %s has closed the connection.", socket_path.c_str()));
+    }
+}
+
+auto ScrubClient::frame(double time, ScrubFormat format) -> Frame
+{
+    send_request(FRAME, format, time);
+
+    Response response;
+    if (!receive_all(fd, &response, sizeof(response)) || response.magic != magic)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Server at %s hasn't answered.", socket_path.c_str()));
+    }
+
+    Frame frame = {response.width, response.height, {}};
+    frame.data.resize(response.size);
+    if (response.size > 0 && !receive_all(fd, frame.data.data(), frame.data.size()))
+        throw std::runtime_error("Scrubbing message has been cut short.");
+
+    if (response.status != OK)
+    {
+        throw std::runtime_error(Utils::str_format(
+                "Server cannot render the frame at %g s: %s",
+                time,
+                std::string(frame.data.begin(), frame.data.end()).c_str()));
+    }
+    return frame;
+}
+
+void ScrubClient::stop_server()
+{
+    send_request(STOP, ScrubFormat::RAW, 0);
+    Response response;
+    receive_all(fd, &response, sizeof(response));
+}
+
+} // namespace Sian
@@ -0,0 +1,64 @@
+#include "scrub_protocol.hh"
+#include "utils.hh"
+
+#include <cerrno>
+#include <cstddef> // std::size_t
+#include <cstring> // std::strerror
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+namespace Sian {
+namespace ScrubProtocol {
+
+bool send_all(int fd, const void* data, std::size_t size)
+{
+    const char* bytes = (const char*) data;
+    while (size > 0)
+    {
+        // closed connections must not kill the process by SIGPIPE
+        const ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EPIPE || errno == ECONNRESET)
+                return false;
+            throw std::runtime_error(Utils::str_format(
+                    "Cannot send a scrubbing message: %s", std::strerror(errno)));
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool receive_all(int fd, void* data, std::size_t size)
+{
+    char* bytes = (char*) data;
+    std::size_t received = 0;
+    while (received < size)
+    {
+        const ssize_t count = recv(fd, bytes + received, size - received, 0);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == ECONNRESET && received == 0)
+                return false;
+            throw std::runtime_error(Utils::str_format(
+                    "Cannot receive a scrubbing message: %s", std::strerror(errno)));
+        }
+        if (count == 0)
+        {
+            if (received == 0)
+                return false;
+            throw std::runtime_error("Scrubbing message has been cut short.");
+        }
+        received += count;
+    }
+    return true;
+}
+
+} // namespace Sian::ScrubProtocol
+} // namespace Sian
@@ -0,0 +1,62 @@
+#ifndef SCRUB_PROTOCOL_HH
+#define SCRUB_PROTOCOL_HH
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+
+namespace Sian {
+namespace ScrubProtocol {
+
+// Messages exchanged by ScrubServer and ScrubClient over a UNIX domain socket. Both ends run
+// on the same host, so the messages are sent in the native byte order. A client sends any
+// number of requests over one connection, each answered by a response followed by size
+// bytes of payload: the frame if the status is OK, or an error message otherwise.
+
+const std::uint32_t magic = 0x53435242;
+const std::uint32_t version = 1;
+
+enum RequestType : std::uint32_t
+{
+    FRAME = 0,
+    // stops the server once the connections of all other clients are closed
+    STOP = 1
+};
+
+enum Status : std::uint32_t
+{
+    OK = 0,
+    ERROR = 1
+};
+
+struct Request
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t type;
+    // value of ScrubFormat
+    std::uint32_t format;
+    // in seconds
+    double time;
+};
+
+struct Response
+{
+    std::uint32_t magic;
+    std::uint32_t status;
+    std::int32_t width;
+    std::int32_t height;
+    std::uint64_t size;
+};
+
+// Sends the whole buffer. Returns false if the peer has closed the connection, throws
+// std::runtime_error on other errors.
+bool send_all(int fd, const void* data, std::size_t size);
+
+// Fills the whole buffer. Returns false if the peer has closed the connection before sending
+// anything, throws std::runtime_error on other errors, including a message cut short.
+bool receive_all(int fd, void* data, std::size_t size);
+
+} // namespace Sian::ScrubProtocol
+} // namespace Sian
+
+#endif
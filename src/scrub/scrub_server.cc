@@ -0,0 +1,250 @@
+#include "scene.hh"
+#include "scrub/scrub_protocol.hh"
+#include "scrub/scrub_server.hh"
+#include "utils.hh"
+
+#include <cairo.h>
+
+#include <cerrno>
+#include <cmath> // std::lround
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstring> // std::memcpy, std::strerror, std::strlen, std::strncpy
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace Sian {
+
+using namespace ScrubProtocol;
+
+namespace {
+
+// Packs the rows of the frame next to each other.
+void copy_raw(const Scene::Snapshot::Pixels& pixels, std::vector<unsigned char>& out)
+{
+    const std::size_t row_size = (std::size_t) pixels.width * 4;
+    out.resize(row_size * pixels.height);
+    for (int y = 0; y < pixels.height; ++y)
+    {
+        std::memcpy(
+                out.data() + row_size * y,
+                pixels.data + (std::size_t) pixels.stride * y,
+                row_size);
+    }
+}
+
+bool send_response(
+        int fd,
+        Status status,
+        int width,
+        int height,
+        const void* payload,
+        std::size_t size)
+{
+    const Response response = {magic, status, width, height, size};
+    return send_all(fd, &response, sizeof(response)) &&
+           (size == 0 || send_all(fd, payload, size));
+}
+
+bool send_error(int fd, const char* message)
+{
+    return send_response(fd, ERROR, 0, 0, message, std::strlen(message));
+}
+
+} // namespace Sian::{anonymous}
+
+ScrubServer::ScrubServer(
+        const std::string& socket_path,
+        double fps,
+        long last_frame,
+        int workers,
+        std::size_t cached_frames,
+        const PngOptions& png_options,
+        const Renderer& render)
+    : socket_path(socket_path),
+      fps(fps),
+      last_frame(last_frame),
+      workers(workers),
+      cached_frames(cached_frames),
+      png_options(png_options),
+      render(render),
+      stopping(false)
+{
+    if (workers < 1)
+        throw std::invalid_argument("Scrubbing server needs at least one worker.");
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+    {
+        throw std::invalid_argument(Utils::str_format(
+                "Socket path %s is too long.", socket_path.c_str()));
+    }
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    // a socket left behind by a previous server would make bind() fail
+    unlink(socket_path.c_str());
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 ||
+        bind(listen_fd, (const sockaddr*) &address, sizeof(address)) != 0 ||
+        listen(listen_fd, workers) != 0)
+    {
+        const int error = errno;
+        if (listen_fd >= 0)
+            ::close(listen_fd);
+        throw std::runtime_error(Utils::str_format(
+                "Cannot listen on %s: %s", socket_path.c_str(), std::strerror(error)));
+    }
+}
+
+ScrubServer::~ScrubServer()
+{
+    ::close(listen_fd);
+    unlink(socket_path.c_str());
+}
+
+void ScrubServer::run()
+{
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; ++i)
+    {
+        threads.emplace_back(&ScrubServer::serve_connections, this);
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ScrubServer::serve_connections()
+{
+    while (!stopping)
+    {
+        const int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            // the listening socket is shut down when the server stops
+            if (stopping)
+                break;
+            continue;
+        }
+
+        try
+        {
+            while (answer(fd))
+            { }
+        }
+        catch (const std::exception&)
+        {
+            // the connection is broken, other clients are still served
+        }
+        ::close(fd);
+    }
+}
+
+bool ScrubServer::answer(int fd)
+{
+    Request request;
+    if (!receive_all(fd, &request, sizeof(request)))
+        return false;
+    if (request.magic != magic || request.version != version)
+    {
+        send_error(fd, "Unsupported version of the scrubbing protocol.");
+        return false;
+    }
+
+    switch (request.type)
+    {
+        case FRAME:
+            return send_frame(fd, request.time, (ScrubFormat) request.format);
+        case STOP:
+            stopping = true;
+            // wakes up the workers waiting for connections
+            shutdown(listen_fd, SHUT_RDWR);
+            send_response(fd, OK, 0, 0, nullptr, 0);
+            return false;
+        default:
+            return send_error(fd, "Unknown request.");
+    }
+}
+
+bool ScrubServer::send_frame(int fd, double time, ScrubFormat format)
+{
+    // reused by all frames sent by the same worker
+    thread_local std::vector<unsigned char> buffer;
+    int width = 0;
+    int height = 0;
+    try
+    {
+        if (format != ScrubFormat::RAW && format != ScrubFormat::PNG && format != ScrubFormat::QOI)
+            throw std::invalid_argument("Unknown format of frames.");
+        if (!(time >= 0))
+            throw std::invalid_argument("Time of a frame cannot be negative.");
+        // also keeps huge times from overflowing the index
+        if (!(time * fps < last_frame + 0.5))
+        {
+            throw std::out_of_range(Utils::str_format(
+                    "Time %g s is past the end of the timeline at %g s.", time, last_frame / fps));
+        }
+
+        const Scene::Snapshot snapshot = frame(std::lround(time * fps));
+        const Scene::Snapshot::Pixels pixels = snapshot.pixels();
+        width = pixels.width;
+        height = pixels.height;
+        if (format == ScrubFormat::RAW)
+            copy_raw(pixels, buffer);
+        else
+            snapshot.encode(
+                    format == ScrubFormat::PNG ? ImageFormat::PNG : ImageFormat::QOI,
+                    png_options,
+                    buffer);
+    }
+    catch (const std::exception& e)
+    {
+        return send_error(fd, e.what());
+    }
+    return send_response(fd, OK, width, height, buffer.data(), buffer.size());
+}
+
+Scene::Snapshot ScrubServer::frame(long index)
+{
+    const auto lookup = [this, index] (Scene::Snapshot& snapshot)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = cache_index.find(index);
+        if (it == cache_index.end())
+            return false;
+        cache.splice(cache.begin(), cache, it->second);
+        snapshot = it->second->second;
+        return true;
+    };
+
+    Scene::Snapshot snapshot(nullptr);
+    if (lookup(snapshot))
+        return snapshot;
+
+    std::lock_guard<std::mutex> render_lock(render_mutex);
+    // another worker may have rendered the frame in the meantime
+    if (lookup(snapshot))
+        return snapshot;
+    snapshot = render(index);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cache.emplace_front(index, snapshot);
+    cache_index[index] = cache.begin();
+    if (cache.size() > cached_frames)
+    {
+        cache_index.erase(cache.back().first);
+        cache.pop_back();
+    }
+    return snapshot;
+}
+
+} // namespace Sian
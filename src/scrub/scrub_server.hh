@@ -0,0 +1,81 @@
+#ifndef SCRUB_SERVER_HH
+#define SCRUB_SERVER_HH
+
+#include "config.hh"
+#include "scene.hh"
+#include "scrub_client.hh"
+
+#include <atomic>
+#include <cstddef> // std::size_t
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility> // std::pair
+#include <vector>
+
+namespace Sian {
+
+// Answers requests of ScrubClients for frames at any time, sent over a UNIX domain socket.
+// Every worker thread serves one connection at a time. Frames are rendered one at a time,
+// the recently rendered ones are kept for further requests. Encoding and sending them
+// happens in parallel.
+class ScrubServer
+{
+public:
+    // Renders the frame with the given index.
+    using Renderer = std::function<Scene::Snapshot(long)>;
+
+    // Frames after the last one are refused.
+    ScrubServer(
+            const std::string& socket_path,
+            double fps,
+            long last_frame,
+            int workers,
+            std::size_t cached_frames,
+            const PngOptions& png_options,
+            const Renderer& render);
+
+    ScrubServer(const ScrubServer& other) = delete;
+
+    // Removes the socket.
+    ~ScrubServer();
+
+    // Serves requests until a client stops the server and all connections are closed.
+    void run();
+
+private:
+    void serve_connections();
+
+    // Returns false once the connection should be closed.
+    bool answer(int fd);
+
+    // Sends the frame closest to the time, rendering it if it isn't cached.
+    bool send_frame(int fd, double time, ScrubFormat format);
+
+    Scene::Snapshot frame(long index);
+
+    std::string socket_path;
+    double fps;
+    long last_frame;
+    int workers;
+    std::size_t cached_frames;
+    PngOptions png_options;
+    Renderer render;
+
+    int listen_fd = -1;
+    std::atomic<bool> stopping;
+
+    // serializes rendering
+    std::mutex render_mutex;
+    // guards the cache
+    std::mutex cache_mutex;
+    // the most recently used frames first
+    std::list<std::pair<long, Scene::Snapshot>> cache;
+    std::unordered_map<long, std::list<std::pair<long, Scene::Snapshot>>::iterator> cache_index;
+};
+
+} // namespace Sian
+
+#endif
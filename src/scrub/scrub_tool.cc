@@ -0,0 +1,63 @@
+// Command line stand-in for a scrubbing client, for testing Animator::serve():
+//
+//   sian_scrub SOCKET TIME raw|png|qoi OUTPUT   saves the frame at TIME (in seconds) into OUTPUT
+//   sian_scrub SOCKET stop                      stops the server
+
+#include "scrub_client.hh"
+
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace Sian;
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc == 3 && std::string(argv[2]) == "stop")
+        {
+            ScrubClient(argv[1]).stop_server();
+            return 0;
+        }
+        if (argc != 5)
+        {
+            std::cerr << "Usage: " << argv[0] << " SOCKET TIME raw|png|qoi OUTPUT" << std::endl
+                      << "       " << argv[0] << " SOCKET stop" << std::endl;
+            return 2;
+        }
+
+        const std::string format_name = argv[3];
+        ScrubFormat format;
+        if (format_name == "raw")
+            format = ScrubFormat::RAW;
+        else if (format_name == "png")
+            format = ScrubFormat::PNG;
+        else if (format_name == "qoi")
+            format = ScrubFormat::QOI;
+        else
+            throw std::invalid_argument("Unknown format " + format_name + ".");
+
+        ScrubClient client(argv[1]);
+        const auto start = std::chrono::steady_clock::now();
+        const ScrubClient::Frame frame = client.frame(std::stod(argv[2]), format);
+        const std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+
+        std::ofstream output(argv[4], std::ios::binary);
+        output.write((const char*) frame.data.data(), frame.data.size());
+        if (!output)
+            throw std::runtime_error(std::string("Cannot write ") + argv[4] + ".");
+
+        std::cout << frame.width << "x" << frame.height << ", " << frame.data.size()
+                  << " bytes in " << elapsed.count() << " ms" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,163 @@
+#include "spatial_grid.hh"
+
+#include <algorithm> // std::find, std::max, std::min, std::sort
+#include <cmath> // std::ceil, std::floor
+#include <cstddef> // std::size_t
+#include <vector>
+
+namespace Sian {
+
+bool Box::intersects(const Box& other) const
+{
+    return left <= other.right && other.left <= right &&
+           top <= other.bottom && other.top <= bottom;
+}
+
+bool Box::contains(const Box& other) const
+{
+    return left <= other.left && other.right <= right &&
+           top <= other.top && other.bottom <= bottom;
+}
+
+bool SpatialGrid::CellRange::empty() const
+{
+    return x_from > x_to || y_from > y_to;
+}
+
+SpatialGrid::SpatialGrid(const Box& area, double cell_size)
+    : area(area),
+      cell_size(cell_size),
+      columns(std::max(1, (int) std::ceil((area.right - area.left) / cell_size))),
+      rows(std::max(1, (int) std::ceil((area.bottom - area.top) / cell_size))),
+      cells(columns * rows)
+{ }
+
+void SpatialGrid::update(std::size_t id, const Box& box)
+{
+    if (id >= entries.size())
+    {
+        entries.resize(id + 1);
+        visit_marks.resize(id + 1, 0);
+    }
+
+    Entry& entry = entries[id];
+    const CellRange range = cells_of(box);
+    if (entry.present)
+    {
+        const CellRange& old = entry.cells;
+        if (old.x_from == range.x_from && old.y_from == range.y_from &&
+            old.x_to == range.x_to && old.y_to == range.y_to)
+        {
+            // still in the same cells
+            entry.box = box;
+            return;
+        }
+        remove_from_cells(id, old);
+    }
+
+    entry.present = true;
+    entry.box = box;
+    entry.cells = range;
+    insert_into_cells(id, range);
+}
+
+void SpatialGrid::remove(std::size_t id)
+{
+    if (id >= entries.size() || !entries[id].present)
+        return;
+    remove_from_cells(id, entries[id].cells);
+    entries[id].present = false;
+}
+
+void SpatialGrid::query(const Box& box, std::vector<std::size_t>& result) const
+{
+    // visiting all cells costs their number and the ids in them, which is more than scanning
+    // the entries unless most boxes lie outside of the area
+    if (box.contains(area) && entries.size() <= cells.size() + occupancy)
+    {
+        for (std::size_t id = 0; id < entries.size(); ++id)
+        {
+            const Entry& entry = entries[id];
+            if (entry.present && !entry.cells.empty() && entry.box.intersects(box))
+                result.push_back(id);
+        }
+        return;
+    }
+
+    if (++visit_stamp == 0)
+    {
+        // the stamp overflowed, marks from the past might collide with the new stamp
+        std::fill(visit_marks.begin(), visit_marks.end(), 0);
+        visit_stamp = 1;
+    }
+
+    const std::size_t first = result.size();
+    const CellRange range = cells_of(box);
+    for (int y = range.y_from; y <= range.y_to; ++y)
+    {
+        for (int x = range.x_from; x <= range.x_to; ++x)
+        {
+            for (std::size_t id : cells[y * columns + x])
+            {
+                if (visit_marks[id] == visit_stamp)
+                    continue;
+                visit_marks[id] = visit_stamp;
+                if (entries[id].box.intersects(box))
+                    result.push_back(id);
+            }
+        }
+    }
+    std::sort(result.begin() + first, result.end());
+}
+
+SpatialGrid::CellRange SpatialGrid::cells_of(const Box& box) const
+{
+    if (!box.intersects(area))
+        return {0, 0, -1, -1};
+
+    const auto column = [this] (double x) {
+        return std::min(columns - 1, std::max(0, (int) std::floor((x - area.left) / cell_size)));
+    };
+    const auto row = [this] (double y) {
+        return std::min(rows - 1, std::max(0, (int) std::floor((y - area.top) / cell_size)));
+    };
+    return {column(box.left), row(box.top), column(box.right), row(box.bottom)};
+}
+
+void SpatialGrid::insert_into_cells(std::size_t id, const CellRange& range)
+{
+    for (int y = range.y_from; y <= range.y_to; ++y)
+    {
+        for (int x = range.x_from; x <= range.x_to; ++x)
+        {
+            cell(x, y).push_back(id);
+            ++occupancy;
+        }
+    }
+}
+
+void SpatialGrid::remove_from_cells(std::size_t id, const CellRange& range)
+{
+    for (int y = range.y_from; y <= range.y_to; ++y)
+    {
+        for (int x = range.x_from; x <= range.x_to; ++x)
+        {
+            auto& ids = cell(x, y);
+            auto it = std::find(ids.begin(), ids.end(), id);
+            if (it != ids.end())
+            {
+                // order within a cell doesn't matter
+                *it = ids.back();
+                ids.pop_back();
+                --occupancy;
+            }
+        }
+    }
+}
+
+std::vector<std::size_t>& SpatialGrid::cell(int x, int y)
+{
+    return cells[y * columns + x];
+}
+
+} // namespace Sian
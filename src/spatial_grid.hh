@@ -0,0 +1,79 @@
+#ifndef SPATIAL_GRID_HH
+#define SPATIAL_GRID_HH
+
+#include <cstddef> // std::size_t
+#include <vector>
+
+namespace Sian {
+
+struct Box
+{
+    double left;
+    double top;
+    double right;
+    double bottom;
+
+    bool intersects(const Box& other) const;
+
+    bool contains(const Box& other) const;
+};
+
+// Uniform grid over a rectangular area, indexing boxes identified by small integers.
+// Boxes lying completely outside of the area are remembered, but never reported.
+class SpatialGrid
+{
+public:
+    SpatialGrid(const Box& area, double cell_size);
+
+    // Inserts the box with given id, or moves it if it's already present.
+    void update(std::size_t id, const Box& box);
+
+    void remove(std::size_t id);
+
+    // Appends ids of all boxes intersecting the query box to result, in ascending order. Either
+    // the cells covered by the box are visited, or all entries are scanned if that's cheaper.
+    void query(const Box& box, std::vector<std::size_t>& result) const;
+
+private:
+    struct CellRange
+    {
+        int x_from;
+        int y_from;
+        int x_to;
+        int y_to;
+
+        bool empty() const;
+    };
+
+    struct Entry
+    {
+        bool present = false;
+        Box box;
+        CellRange cells;
+    };
+
+    CellRange cells_of(const Box& box) const;
+
+    void insert_into_cells(std::size_t id, const CellRange& range);
+
+    void remove_from_cells(std::size_t id, const CellRange& range);
+
+    std::vector<std::size_t>& cell(int x, int y);
+
+    const Box area;
+    const double cell_size;
+    const int columns;
+    const int rows;
+    std::vector<std::vector<std::size_t>> cells;
+    // number of ids in all cells together, those of boxes spanning more cells counted repeatedly
+    std::size_t occupancy = 0;
+    std::vector<Entry> entries;
+
+    // used for deduplication of ids that are present in more cells
+    mutable std::vector<unsigned> visit_marks;
+    mutable unsigned visit_stamp = 0;
+};
+
+} // namespace Sian
+
+#endif
@@ -83,6 +83,16 @@ auto compose(Fs... functions)
     return FuncComposition<Fs...>(std::forward<Fs>(functions)...);
 }
 
+// Appends the extension (including the dot) to a filename that doesn't end with it yet.
+// A filename equal to the extension gets it appended as well.
+inline std::string with_extension(const std::string& filename, const std::string& ext)
+{
+    if (filename.size() < ext.size() + 1 ||
+        filename.compare(filename.size() - ext.size(), ext.size(), ext) != 0)
+        return filename + ext;
+    return filename;
+}
+
 // std::identity exists since C++20
 template<typename T>
 T identity(T x)
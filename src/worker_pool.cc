@@ -0,0 +1,125 @@
+#include "worker_pool.hh"
+
+#include <algorithm> // std::max, std::min
+#include <cstddef> // std::size_t
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace Sian {
+
+WorkerPool::WorkerPool(int thread_count)
+{
+    if (thread_count < 1)
+        throw std::invalid_argument("A worker pool needs at least one thread.");
+
+    for (int i = 1; i < thread_count; ++i)
+    {
+        threads.emplace_back(&WorkerPool::work, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    run_started.notify_all();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+int WorkerPool::size() const
+{
+    return threads.size() + 1;
+}
+
+void WorkerPool::run(int threads, std::size_t count, const std::function<void(std::size_t)>& task)
+{
+    threads = std::min(threads, size());
+    if (threads <= 1 || count <= 1)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->count = count;
+        chunk = std::max<std::size_t>(1, count / (threads * 16));
+        participants = threads;
+        next_index = 0;
+        error = nullptr;
+        busy_workers = this->threads.size();
+        ++run_id;
+    }
+    run_started.notify_all();
+    take_chunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    worker_done.wait(lock, [this] { return busy_workers == 0; });
+    this->task = nullptr;
+    if (error)
+    {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+void WorkerPool::work(int worker)
+{
+    unsigned long last_run_id = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        run_started.wait(lock, [&] { return stopping || run_id != last_run_id; });
+        if (stopping)
+            return;
+        last_run_id = run_id;
+
+        // workers beyond the threads asked for by the run sit it out
+        if (worker < participants)
+        {
+            lock.unlock();
+            take_chunks();
+            lock.lock();
+        }
+        if (--busy_workers == 0)
+            worker_done.notify_one();
+    }
+}
+
+void WorkerPool::take_chunks()
+{
+    for (std::size_t from = next_index.fetch_add(chunk); from < count;
+         from = next_index.fetch_add(chunk))
+    {
+        const std::size_t to = std::min(count, from + chunk);
+        try
+        {
+            for (std::size_t i = from; i < to; ++i)
+            {
+                (*task)(i);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+            next_index = count;
+        }
+    }
+}
+
+} // namespace Sian
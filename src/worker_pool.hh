@@ -0,0 +1,62 @@
+#ifndef WORKER_POOL_HH
+#define WORKER_POOL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef> // std::size_t
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Sian {
+
+// Threads kept for running tasks in parallel, so that they aren't started again for every
+// frame. The thread calling run() takes part in the work, so a pool of n threads starts
+// n - 1 of them. Only one thread at a time may run tasks.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int thread_count);
+
+    WorkerPool(const WorkerPool& other) = delete;
+
+    ~WorkerPool();
+
+    int size() const;
+
+    // Runs the task for every index below count on at most the given number of threads and
+    // returns once all have finished. Threads take chunks of consecutive indices, so that
+    // threads with light tasks can help the others. Throws the first error thrown by the task,
+    // the remaining indices are skipped then.
+    void run(int threads, std::size_t count, const std::function<void(std::size_t)>& task);
+
+private:
+    void work(int worker);
+
+    // Runs the task for chunks of indices until none are left.
+    void take_chunks();
+
+    std::mutex mutex;
+    // notified when a run starts or the pool stops
+    std::condition_variable run_started;
+    // notified when a worker has finished its part of a run
+    std::condition_variable worker_done;
+    // the current run, changed only while no worker takes part in any
+    const std::function<void(std::size_t)>* task = nullptr;
+    std::size_t count = 0;
+    std::size_t chunk = 1;
+    int participants = 0;
+    std::atomic<std::size_t> next_index{0};
+    // increases with every run, so that workers take part in each only once
+    unsigned long run_id = 0;
+    int busy_workers = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::vector<std::thread> threads;
+};
+
+} // namespace Sian
+
+#endif